@@ -0,0 +1,144 @@
+#include <OpenGL/FrameTextures.h>
+
+#include <core/FrameStore.hpp>
+#include <utils.h>
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+void FrameTextures::Sync(const FrameStore &store) {
+	m_store = &store;
+
+	bool unchanged = m_slots.size() == store.Size();
+	for (size_t i = 0; i < store.Size() && unchanged; i++) {
+		unchanged = !m_slots[i].texture || m_slots[i].version == store.Version(i);
+	}
+	if (unchanged) {
+		Trim();
+		return;
+	}
+
+	PROFILE_FUNCTION();
+
+	std::unordered_map<uint64_t, size_t> resident;
+	for (size_t i = 0; i < m_slots.size(); i++) {
+		if (m_slots[i].texture) {
+			resident.emplace(m_slots[i].version, i);
+		}
+	}
+
+	std::vector<Slot> slots(store.Size());
+	for (size_t i = 0; i < store.Size(); i++) {
+		auto it = resident.find(store.Version(i));
+		if (it != resident.end()) {
+			slots[i] = std::move(m_slots[it->second]);
+		}
+	}
+
+	// the textures left over (dirty or removed frames) go to the frames
+	// without one in order, so a dirty frame usually keeps its own texture
+	// and is updated in place the next time it's drawn
+	size_t next = 0;
+	for (size_t i = 0; i < store.Size(); i++) {
+		if (slots[i].texture) {
+			continue;
+		}
+		while (next < m_slots.size() && !m_slots[next].texture) {
+			next++;
+		}
+		if (next == m_slots.size()) {
+			break;
+		}
+		slots[i] = std::move(m_slots[next++]);
+	}
+	for (auto &slot : m_slots) {
+		if (slot.texture) {
+			m_resident--;
+		}
+	}
+
+	m_slots = std::move(slots);
+	Trim();
+}
+
+int FrameTextures::Width(size_t index) const { return m_store->Get(index).Width(); }
+
+int FrameTextures::Height(size_t index) const { return m_store->Get(index).Height(); }
+
+const std::shared_ptr<Texture> &FrameTextures::Get(size_t index) {
+	Slot &slot = m_slots[index];
+	slot.last_used = ImGui::GetFrameCount();
+	if (slot.texture && slot.version == m_store->Version(index)) {
+		return slot.texture;
+	}
+
+	PROFILE_FUNCTION();
+	if (!slot.texture) {
+		slot.texture = TakeTexture();
+	}
+	slot.texture->Load(m_store->Get(index));
+	slot.version = m_store->Version(index);
+	return slot.texture;
+}
+
+void FrameTextures::Prefetch(size_t index, int radius) {
+	for (int offset = 1; offset <= radius; offset++) {
+		for (int64_t i : {(int64_t)index + offset, (int64_t)index - offset}) {
+			if (i < 0 || i >= (int64_t)m_slots.size()) {
+				continue;
+			}
+			Slot &slot = m_slots[i];
+			if (!slot.texture || slot.version != m_store->Version(i)) {
+				Get(i);
+				return;
+			}
+			// keeps it from being taken before it's needed
+			slot.last_used = ImGui::GetFrameCount();
+		}
+	}
+}
+
+std::shared_ptr<Texture> FrameTextures::TakeTexture() {
+	if (m_resident < m_capacity) {
+		m_resident++;
+		return std::make_shared<Texture>();
+	}
+
+	int frame = ImGui::GetFrameCount();
+	Slot *oldest = nullptr;
+	for (auto &slot : m_slots) {
+		if (slot.texture && slot.last_used < frame && (!oldest || slot.last_used < oldest->last_used)) {
+			oldest = &slot;
+		}
+	}
+	if (!oldest) {
+		// everything resident is on screen, go over capacity until Trim
+		m_resident++;
+		return std::make_shared<Texture>();
+	}
+	// same sized frames, so the next Load only updates the texture
+	return std::move(oldest->texture);
+}
+
+void FrameTextures::Trim() {
+	if (m_resident <= m_capacity) {
+		return;
+	}
+
+	std::vector<Slot *> evictable;
+	int frame = ImGui::GetFrameCount();
+	for (auto &slot : m_slots) {
+		if (slot.texture && slot.last_used < frame) {
+			evictable.push_back(&slot);
+		}
+	}
+	size_t count = std::min(m_resident - m_capacity, evictable.size());
+	std::partial_sort(evictable.begin(), evictable.begin() + count, evictable.end(),
+			  [](const Slot *a, const Slot *b) { return a->last_used < b->last_used; });
+	for (size_t i = 0; i < count; i++) {
+		evictable[i]->texture.reset();
+	}
+	m_resident -= count;
+}
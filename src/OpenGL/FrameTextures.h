@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <OpenGL/Texture.h>
+
+class FrameStore;
+
+// Textures for drawing the frames of a FrameStore. The store holds the pixels,
+// this is only a display cache and nothing is ever read back from the GPU.
+//
+// Only a bounded number of frames are resident: Get uploads a frame when it's
+// drawn and, once the cache is full, takes the texture of the least recently
+// drawn frame for it. Textures drawn in the current UI frame are never taken,
+// so the limit is soft while more frames than that are on screen at once.
+class FrameTextures {
+      public:
+	explicit FrameTextures(size_t capacity = 32) : m_capacity(capacity) {}
+
+	// GL thread only. Picks up added, removed and dirty frames, nothing is
+	// uploaded until the frames are drawn. Textures of removed frames are
+	// reused by their frames' new positions.
+	void Sync(const FrameStore &store);
+
+	size_t Size() const { return m_slots.size(); }
+	bool Empty() const { return m_slots.empty(); }
+	// from the store, so they don't make the frame resident
+	int Width(size_t index) const;
+	int Height(size_t index) const;
+
+	// The texture of a frame, uploaded first if it isn't resident or the
+	// frame changed. Only valid until the next Get or Sync.
+	const std::shared_ptr<Texture> &Get(size_t index);
+	// Uploads one not yet resident frame within `radius` of index, so
+	// stepping through the sequence finds the next frame on the GPU
+	void Prefetch(size_t index, int radius = 1);
+
+	size_t Capacity() const { return m_capacity; }
+	void SetCapacity(size_t capacity) { m_capacity = capacity; }
+	size_t Resident() const { return m_resident; }
+
+      private:
+	struct Slot {
+		std::shared_ptr<Texture> texture;
+		// the store version of the frame that's in the texture
+		uint64_t version = 0;
+		// UI frame the texture was last drawn in
+		int last_used = -1;
+	};
+
+	// a new texture while under capacity, otherwise the least recently used one
+	std::shared_ptr<Texture> TakeTexture();
+	// frees the least recently used textures until the cache is within capacity
+	void Trim();
+
+	const FrameStore *m_store = nullptr;
+	std::vector<Slot> m_slots;
+	size_t m_capacity;
+	size_t m_resident = 0;
+};
@@ -0,0 +1,155 @@
+#include <OpenGL/FrameThumbnails.h>
+
+#include <core/FrameStore.hpp>
+#include <core/ThreadPool.hpp>
+#include <utils.h>
+
+#include <chrono>
+
+// how long Sync may spend on uploads per call, the rest waits for the next one
+static constexpr auto kUploadBudget = std::chrono::milliseconds(4);
+
+FrameThumbnails::~FrameThumbnails() { CancelRequests(); }
+
+void FrameThumbnails::Sync(const FrameStore &store) {
+	bool unchanged = m_versions.size() == store.Size();
+	for (size_t i = 0; i < store.Size() && unchanged; i++) {
+		unchanged = m_versions[i] == store.Version(i);
+	}
+	if (!unchanged) {
+		Relayout(store);
+	}
+	if (!m_requests.empty()) {
+		UploadFinished();
+	}
+}
+
+void FrameThumbnails::Relayout(const FrameStore &store) {
+	PROFILE_FUNCTION();
+
+	if (store.Empty()) {
+		CancelRequests();
+		m_atlases.clear();
+		m_thumbnails.clear();
+		m_versions.clear();
+		m_cells.clear();
+		m_free_cells.clear();
+		m_next_cell = 0;
+		return;
+	}
+
+	std::unordered_map<uint64_t, size_t> existing;
+	for (size_t i = 0; i < m_versions.size(); i++) {
+		if (m_cells[i] >= 0) {
+			existing.emplace(m_versions[i], i);
+		}
+	}
+
+	std::vector<Thumbnail> thumbnails(store.Size());
+	std::vector<uint64_t> versions(store.Size());
+	std::vector<int> cells(store.Size(), -1);
+	std::unordered_map<uint64_t, Request> requests;
+	for (size_t i = 0; i < store.Size(); i++) {
+		versions[i] = store.Version(i);
+		auto it = existing.find(versions[i]);
+		if (it != existing.end()) {
+			thumbnails[i] = m_thumbnails[it->second];
+			cells[i] = m_cells[it->second];
+			existing.erase(it);
+			continue;
+		}
+
+		// still being made from the same pixels, the frame may just have moved
+		auto request = m_requests.find(versions[i]);
+		if (request != m_requests.end()) {
+			requests.emplace(versions[i], Request{request->second.token, i});
+			m_requests.erase(request);
+			continue;
+		}
+
+		// the frame is shared with the task, not copied
+		CancellationToken token;
+		requests.emplace(versions[i], Request{token, i});
+		ThreadPool::GetThreadPool().submit(
+		    [ready = m_ready, token, version = versions[i], frame = store.Get(i)]() {
+			    if (token.is_cancelled()) {
+				    return;
+			    }
+			    Frame thumbnail(utils::MakeThumbnail(frame, kSize));
+			    std::unique_lock<std::mutex> lock(ready->mutex);
+			    ready->thumbnails.emplace_back(version, std::move(thumbnail));
+		    },
+		    TaskPriority::Normal);
+	}
+	for (auto &[version, index] : existing) {
+		m_free_cells.push_back(m_cells[index]);
+	}
+	// frames that were removed or changed again before their thumbnail was done
+	CancelRequests();
+
+	m_thumbnails = std::move(thumbnails);
+	m_versions = std::move(versions);
+	m_cells = std::move(cells);
+	m_requests = std::move(requests);
+}
+
+void FrameThumbnails::UploadFinished() {
+	PROFILE_FUNCTION();
+
+	auto start = std::chrono::steady_clock::now();
+	while (std::chrono::steady_clock::now() - start < kUploadBudget) {
+		std::pair<uint64_t, Frame> ready;
+		{
+			std::unique_lock<std::mutex> lock(m_ready->mutex);
+			if (m_ready->thumbnails.empty()) {
+				return;
+			}
+			ready = std::move(m_ready->thumbnails.front());
+			m_ready->thumbnails.pop_front();
+		}
+
+		// made for a version that's gone by now
+		auto request = m_requests.find(ready.first);
+		if (request == m_requests.end()) {
+			continue;
+		}
+		size_t frame = request->second.index;
+		m_requests.erase(request);
+
+		if (m_free_cells.empty()) {
+			m_cells[frame] = m_next_cell++;
+		} else {
+			m_cells[frame] = m_free_cells.back();
+			m_free_cells.pop_back();
+		}
+		m_thumbnails[frame] = Upload(m_cells[frame], ready.second);
+	}
+}
+
+void FrameThumbnails::CancelRequests() {
+	for (auto &[version, request] : m_requests) {
+		request.token.cancel();
+	}
+	m_requests.clear();
+}
+
+FrameThumbnails::Thumbnail FrameThumbnails::Upload(int cell, const Frame &image) {
+	size_t atlas = cell / kCellsPerAtlas;
+	while (m_atlases.size() <= atlas) {
+		auto texture = std::make_shared<Texture>();
+		texture->Load(Frame(cv::Mat(kAtlasSize, kAtlasSize, CV_8UC4, cv::Scalar::all(0))));
+		m_atlases.push_back(texture);
+	}
+
+	int x = cell % kCellsPerRow * kSize;
+	int y = cell % kCellsPerAtlas / kCellsPerRow * kSize;
+	m_atlases[atlas]->LoadRegion(image, x, y);
+
+	Thumbnail thumbnail;
+	thumbnail.texture = m_atlases[atlas]->GetID();
+	thumbnail.u0 = (float)x / kAtlasSize;
+	thumbnail.v0 = (float)y / kAtlasSize;
+	thumbnail.u1 = (float)(x + image.Width()) / kAtlasSize;
+	thumbnail.v1 = (float)(y + image.Height()) / kAtlasSize;
+	return thumbnail;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <OpenGL/Texture.h>
+#include <core/Frame.hpp>
+#include <core/ThreadPool.hpp>
+
+class FrameStore;
+
+// Small copies of the frames of a FrameStore for the frame grids. They're
+// downsampled on the CPU once per frame version and packed into atlas
+// textures, so a grid of hundreds of frames samples a few small textures
+// instead of every full resolution one. The downsampling runs in the
+// background and finished thumbnails are uploaded a few at a time, frames
+// without one yet have an empty thumbnail meanwhile.
+class FrameThumbnails {
+      public:
+	FrameThumbnails() = default;
+	~FrameThumbnails();
+
+	FrameThumbnails(const FrameThumbnails &) = delete;
+	FrameThumbnails &operator=(const FrameThumbnails &) = delete;
+
+	// longest side of a thumbnail, in pixels
+	static constexpr int kSize = 128;
+
+	// where a thumbnail is in its atlas, for ImGui::Image(texture, size, uv0, uv1)
+	struct Thumbnail {
+		unsigned int texture = 0;
+		float u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+	};
+
+	// GL thread only, once per UI frame while the thumbnails are shown. New
+	// and dirty frames are queued for downsampling on the pool and the
+	// thumbnails finished since the last call are uploaded, within a budget.
+	void Sync(const FrameStore &store);
+	// true while thumbnails are still being made, the UI has to keep calling
+	// Sync until they're all there
+	bool Pending() const { return !m_requests.empty(); }
+
+	size_t Size() const { return m_thumbnails.size(); }
+	bool Empty() const { return m_thumbnails.empty(); }
+	const Thumbnail &Get(size_t index) const { return m_thumbnails[index]; }
+
+      private:
+	static constexpr int kAtlasSize = 2048;
+	static constexpr int kCellsPerRow = kAtlasSize / kSize;
+	static constexpr int kCellsPerAtlas = kCellsPerRow * kCellsPerRow;
+
+	// downsampled frames waiting for their upload, shared with the pool tasks
+	struct ReadyQueue {
+		std::mutex mutex;
+		std::deque<std::pair<uint64_t, Frame>> thumbnails;
+	};
+	// a frame version being downsampled and the frame it's for
+	struct Request {
+		CancellationToken token;
+		size_t index;
+	};
+
+	// matches the thumbnails to the frames of the store and requests the
+	// missing ones
+	void Relayout(const FrameStore &store);
+	void UploadFinished();
+	void CancelRequests();
+
+	// uploads a thumbnail into its cell, adding an atlas if needed
+	Thumbnail Upload(int cell, const Frame &image);
+
+	std::vector<std::shared_ptr<Texture>> m_atlases;
+	std::vector<Thumbnail> m_thumbnails;
+	// per frame: the store version the thumbnail is for and its atlas cell,
+	// -1 while the thumbnail isn't there yet
+	std::vector<uint64_t> m_versions;
+	std::vector<int> m_cells;
+	std::unordered_map<uint64_t, Request> m_requests;
+	std::shared_ptr<ReadyQueue> m_ready = std::make_shared<ReadyQueue>();
+	// cells of removed frames, reused before new ones are taken
+	std::vector<int> m_free_cells;
+	int m_next_cell = 0;
+};
@@ -1,17 +1,117 @@
 #include <OpenGL/Texture.h>
 
+#include <core/Frame.hpp>
 #include <utils.h>
 
 #include <glad/glad.h>
 
+#include <cstring>
+
+uint64_t Texture::s_version_counter = 0;
+
+// Uploads are staged in a ring of pixel buffers. glTex(Sub)Image2D reads from
+// the buffer on the GPU's time, the fence after it tells when the buffer can be
+// written again. With two buffers the copy of one frame into a buffer overlaps
+// the transfer of the previous frame, only a third upload in a row has to wait.
+struct StreamBuffer {
+	GLuint id = 0;
+	size_t size = 0;
+	GLsync fence = nullptr;
+};
+static constexpr int kStreamBuffers = 2;
+static StreamBuffer s_stream_buffers[kStreamBuffers];
+static int s_next_stream_buffer = 0;
+
+static void WaitForFence(GLsync fence) {
+	while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+	}
+}
+
+// What to pass to glTex(Sub)Image2D for an upload: an offset into the stream
+// buffer that's bound to GL_PIXEL_UNPACK_BUFFER, with the rows packed, or the
+// pixels themselves if no buffer could be mapped
+struct StagedUpload {
+	const void *pixels;
+	bool staged;
+};
+
+static StagedUpload StageUpload(const void *data, size_t row_bytes, size_t stride, int rows) {
+	PROFILE_FUNCTION();
+
+	StreamBuffer &buffer = s_stream_buffers[s_next_stream_buffer];
+	if (buffer.fence) {
+		WaitForFence(buffer.fence);
+		glDeleteSync(buffer.fence);
+		buffer.fence = nullptr;
+	}
+	if (!buffer.id) {
+		glGenBuffers(1, &buffer.id);
+	}
+
+	size_t size = row_bytes * rows;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+	if (size > buffer.size) {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		buffer.size = size;
+	}
+	uint8_t *mapped = (uint8_t *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+						      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	if (!mapped) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return {data, false};
+	}
+	if (stride == row_bytes) {
+		memcpy(mapped, data, size);
+	} else {
+		for (int y = 0; y < rows; y++) {
+			memcpy(mapped + y * row_bytes, (const uint8_t *)data + y * stride, row_bytes);
+		}
+	}
+	if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+		// the contents were lost (e.g. a mode switch), upload from memory
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return {data, false};
+	}
+	s_next_stream_buffer = (s_next_stream_buffer + 1) % kStreamBuffers;
+	return {nullptr, true};
+}
+
+// call after the glTex(Sub)Image2D that read the staged upload
+static void FinishUpload(const StagedUpload &upload) {
+	if (!upload.staged) {
+		return;
+	}
+	StreamBuffer &buffer = s_stream_buffers[(s_next_stream_buffer + kStreamBuffers - 1) % kStreamBuffers];
+	buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void Texture::ReleaseStreamingBuffers() {
+	for (auto &buffer : s_stream_buffers) {
+		if (buffer.fence) {
+			glDeleteSync(buffer.fence);
+		}
+		if (buffer.id) {
+			glDeleteBuffers(1, &buffer.id);
+		}
+		buffer = StreamBuffer();
+	}
+}
+
 Texture::Texture() { glGenTextures(1, &m_id); }
 
 Texture::~Texture() { glDeleteTextures(1, &m_id); }
 
 void Texture::Load(const uint32_t *data, int width, int height) {
-	if (m_loaded && m_width == width && m_height == height) {
+	// textures are only touched from the GL thread so this doesn't need to be atomic
+	m_version = ++s_version_counter;
+
+	StagedUpload upload = StageUpload(data, width * 4, width * 4, height);
+
+	if (m_loaded && m_width == width && m_height == height && m_channels == 4) {
 		Bind();
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, data);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, upload.pixels);
+		FinishUpload(upload);
 		Unbind();
 		return;
 	}
@@ -20,6 +120,10 @@ void Texture::Load(const uint32_t *data, int width, int height) {
 
 	m_width = width;
 	m_height = height;
+	m_channels = 4;
+
+	// the texture may have been a swizzled gray one before
+	GLint swizzle[] = {GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA};
 
 #ifdef __APPLE__
 	glActiveTexture(GL_TEXTURE0);
@@ -30,8 +134,10 @@ void Texture::Load(const uint32_t *data, int width, int height) {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, upload.pixels);
+	FinishUpload(upload);
 
 	glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -43,8 +149,10 @@ void Texture::Load(const uint32_t *data, int width, int height) {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_BGRA, m_width, m_height, 0, GL_BGRA, GL_UNSIGNED_BYTE, data);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_BGRA, m_width, m_height, 0, GL_BGRA, GL_UNSIGNED_BYTE, upload.pixels);
+	FinishUpload(upload);
 
 	Unbind();
 
@@ -53,12 +161,99 @@ void Texture::Load(const uint32_t *data, int width, int height) {
 	m_loaded = true;
 }
 
+void Texture::Load(const Frame &frame) {
+	PixelFormat format = frame.Format();
+	if (format == PixelFormat::BGRA8) {
+		cv::Mat data = frame.data.isContinuous() ? frame.data : frame.data.clone();
+		Load((const uint32_t *)data.data, frame.Width(), frame.Height());
+		return;
+	}
+
+	m_version = ++s_version_counter;
+
+	unsigned int internal_format = GL_R8, type = GL_UNSIGNED_BYTE;
+	if (format == PixelFormat::Gray16) {
+		internal_format = GL_R16;
+		type = GL_UNSIGNED_SHORT;
+	} else if (format == PixelFormat::Gray32F) {
+		internal_format = GL_R32F;
+		type = GL_FLOAT;
+	}
+
+	// staged rows are packed, the frame itself can be a view into a bigger image
+	size_t row_bytes = frame.Width() * frame.data.elemSize();
+	size_t stride = frame.data.step1() * frame.data.elemSize1();
+	StagedUpload upload = StageUpload(frame.data.data, row_bytes, stride, frame.Height());
+
+	Bind();
+	// rows of a gray frame aren't 4 byte aligned in general
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, upload.staged ? 0 : (int)(frame.data.step1()));
+
+	if (m_loaded && m_width == frame.Width() && m_height == frame.Height() && m_channels == 1 &&
+	    m_internal_format == internal_format) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_RED, type, upload.pixels);
+	} else {
+		PROFILE_SCOPE(LoadNonLoaded);
+
+		m_width = frame.Width();
+		m_height = frame.Height();
+		m_channels = 1;
+		m_internal_format = internal_format;
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		// sample as (r, r, r, 1) so ImGui draws it as gray
+		GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+		glTexImage2D(GL_TEXTURE_2D, 0, internal_format, m_width, m_height, 0, GL_RED, type, upload.pixels);
+	}
+	FinishUpload(upload);
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	Unbind();
+
+	m_loaded = true;
+}
+
 // assumes we want to use bytes and not floats
+void Texture::LoadRegion(const Frame &frame, int x, int y) {
+	if (!m_loaded || m_channels != 4 || frame.Format() != PixelFormat::BGRA8 || x < 0 || y < 0 ||
+	    x + frame.Width() > m_width || y + frame.Height() > m_height) {
+		return;
+	}
+	m_version = ++s_version_counter;
+
+	size_t stride = frame.data.step1() * frame.data.elemSize1();
+	StagedUpload upload = StageUpload(frame.data.data, frame.Width() * 4, stride, frame.Height());
+
+	Bind();
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, upload.staged ? 0 : (int)(stride / 4));
+#ifdef __APPLE__
+	// same channel order as the texture was created with, see Load
+	GLenum format = GL_RGBA;
+#else
+	GLenum format = GL_BGRA;
+#endif
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, frame.Width(), frame.Height(), format, GL_UNSIGNED_BYTE,
+			upload.pixels);
+	FinishUpload(upload);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	Unbind();
+}
+
 void Texture::Load(const char *filename) {
 	PROFILE_FUNCTION();
 
 	int width, height;
 	unsigned int *temp = io::LoadTiff(filename, width, height);
+	m_width = width;
+	m_height = height;
+	m_channels = 4;
 	Bind();
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -72,6 +267,7 @@ void Texture::Load(const char *filename) {
 
 	free(temp);
 	m_loaded = true;
+	m_version = ++s_version_counter;
 }
 
 void Texture::GetData(uint32_t *data) {
@@ -80,7 +276,17 @@ void Texture::GetData(uint32_t *data) {
 	Bind();
 	{
 		PROFILE_SCOPE(OpenGLGetData);
-		glGetTexImage(GL_TEXTURE_2D, 0, GL_BGRA, GL_UNSIGNED_BYTE, data);
+		if (m_channels == 1) {
+			// swizzling doesn't apply to reads, gray textures come back as one channel
+			cv::Mat gray(m_height, m_width, CV_8UC1);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_UNSIGNED_BYTE, gray.data);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			cv::Mat bgra(m_height, m_width, CV_8UC4, data);
+			cv::cvtColor(gray, bgra, cv::COLOR_GRAY2BGRA);
+		} else {
+			glGetTexImage(GL_TEXTURE_2D, 0, GL_BGRA, GL_UNSIGNED_BYTE, data);
+		}
 	}
 	Unbind();
 }
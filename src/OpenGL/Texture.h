@@ -1,21 +1,45 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
+struct Frame;
+
+// Uploads are streamed through pixel buffer objects: Load copies the pixels
+// into a buffer and returns while the GPU transfers them into the texture.
 class Texture {
       public:
 	Texture();
 	~Texture();
 	void Load(const unsigned int *data, int width, int height);
+	// Gray frames are uploaded as single channel textures that the GPU
+	// swizzles to gray on sampling, BGRA frames like the overload above
+	void Load(const Frame &frame);
 	void Load(const char *filename);
+	// Writes a BGRA frame into part of an already loaded BGRA texture
+	void LoadRegion(const Frame &frame, int x, int y);
+	// always BGRA, gray textures are expanded
 	void GetData(unsigned int *data);
+
+	// Frees the buffers all uploads are streamed through, while the context
+	// is still current
+	static void ReleaseStreamingBuffers();
 	void Bind();
 	void Unbind();
 	unsigned int GetID() const { return m_id; }
 	int GetWidth() const { return m_width; }
 	int GetHeight() const { return m_height; }
+	// changes every time new pixel data is loaded, unique across all textures
+	// so it can be used as a cache key for anything derived from the pixels
+	uint64_t GetVersion() const { return m_version; }
 
       private:
+	static uint64_t s_version_counter;
+
 	unsigned int m_id;
 	bool m_loaded = false;
 	int m_width = 0, m_height = 0, m_channels = 0;
+	unsigned int m_internal_format = 0;
+	uint64_t m_version = 0;
 	unsigned char *m_data;
 };
@@ -4,11 +4,15 @@
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <stdio.h>
 
 #include <core/CrackDetector.hpp>
 #include <core/DenoiseInterface.hpp>
 #include <core/FeatureTracker.hpp>
+#include <core/Frame.hpp>
+#include <core/FrameCache.hpp>
+#include <core/FrameStore.hpp>
 #include <core/ImageAnalysis.hpp>
 #include <core/Stabilizer.hpp>
 
@@ -30,6 +34,8 @@ struct Settings {
 	std::string widths_output;
 	bool do_widths = false;
 	std::string output;
+	std::string cache;
+	io::TiffWriteOptions tiff_options;
 };
 
 namespace cli {
@@ -43,19 +49,23 @@ bool isFlag(const std::string &arg) {
 void printUsageError(const char *flag, const char *msg, const char *prog_name) {
 	std::cerr << std::string(msg) + " '" + flag + "'\n" +
 			 "Usage: " + prog_name +
-			 " --folder <path> [--crop <pixels>] [--denoise "
-			 "<blur/sfr_hrsem/sfr_lrsem>] [--analyze <output.csv>] "
-			 "[--calculate-widths <widths.csv>] [--output "
-			 "<folder_path>]\n";
+			 " --folder <path|stack.tif> [--crop <pixels>] [--denoise "
+			 "<blur/sfr_hrsem/sfr_lrsem>] [--analyze <output.csv|.cols>] "
+			 "[--calculate-widths <widths.csv|.cols>] [--output "
+			 "<folder_path|stack.tif>] [--cache <file>] "
+			 "[--compression <none/lzw/deflate/zstd>]\n";
 	exit(1);
 }
 
 // Helper to print usage information
 void printUsage(const char *prog_name) {
 	std::cout << "Usage: " << prog_name
-		  << " --folder <path> [--crop <pixels>] [--denoise <blur/...> "
-		     "<tile_size>] [--analyze <output.csv>] "
-		  << "[--calculate-widths <widths.csv>] [--output <path>]\n";
+		  << " --folder <path|stack.tif> [--crop <pixels>] "
+		     "[--denoise <blur/...> "
+		     "<tile_size>] [--analyze <output.csv|.cols>] "
+		  << "[--calculate-widths <widths.csv|.cols>] "
+		  << "[--output <path|stack.tif>] "
+		  << "[--cache <file>] [--compression <none/lzw/deflate/zstd>]\n";
 }
 
 // Parse command line arguments
@@ -174,6 +184,39 @@ Settings parseArguments(int argc, char *argv[]) {
 						  argv[0]);
 		  }},
 		  1}},
+		{"--cache",
+		 {{[&](int &i, int argc, char *argv[]) {
+			  if (i + 1 >= argc)
+				  printUsageError("--cache",
+						  "Missing cache file",
+						  argv[0]);
+			  settings.cache = argv[++i];
+			  if (settings.cache.empty())
+				  printUsageError("--cache",
+						  "Cache file cannot be empty",
+						  argv[0]);
+		  }},
+		  1}},
+		{"--compression",
+		 {{[&](int &i, int argc, char *argv[]) {
+			  if (i + 1 >= argc)
+				  printUsageError("--compression",
+						  "Missing compression type",
+						  argv[0]);
+			  std::string type = argv[++i];
+			  std::map<std::string, io::TiffCompression> types = {
+			      {"none", io::TiffCompression::None},
+			      {"lzw", io::TiffCompression::LZW},
+			      {"deflate", io::TiffCompression::Deflate},
+			      {"zstd", io::TiffCompression::ZSTD}};
+			  if (types.find(type) == types.end())
+				  printUsageError(
+				      "--compression",
+				      "Compression must be none/lzw/deflate/zstd",
+				      argv[0]);
+			  settings.tiff_options.compression = types[type];
+		  }},
+		  1}},
 		{"--help",
 		 {{[&](int &i, int argc, char *argv[]) {
 			  printUsage(argv[0]);
@@ -250,17 +293,40 @@ bool validateSettings(const Settings &settings, char **argv) {
 	return true;
 }
 
-// Load images from folder
-bool loadImages(const Settings &settings, std::vector<uint32_t *> &images,
-		int &width, int &height) {
+// Load images from folder into a single channel store, grayscale tiffs keep
+// their bit depth. With --cache the store holds views into the memory mapped
+// frame cache instead, which is only (re)built when the folder changed.
+bool loadImages(const Settings &settings, FrameCache &cache,
+		FrameStore &store) {
+	auto on_frame = [&](int index, Frame frame) {
+		store.Add(std::move(frame));
+	};
+	auto on_progress = [](int loaded, int total) {
+		printf("\rLoading images %d/%d", loaded, total);
+		if (loaded == total)
+			printf("\n");
+		fflush(stdout);
+	};
 	bool success =
-	    io::LoadTiffFolder(settings.folder.c_str(), images, width, height);
+	    settings.cache.empty()
+		? io::LoadTiffFolderStreamed(settings.folder.c_str(),
+					     on_frame, on_progress)
+		: io::LoadTiffFolderCached(settings.folder.c_str(),
+					   settings.cache.c_str(), cache,
+					   on_frame, on_progress);
 	if (!success) {
 		printf("Failed to load images from %s\n",
 		       settings.folder.c_str());
 		return false;
 	}
+	if (store.Empty()) {
+		return true;
+	}
+	printf("Loaded %d %s images (%.1f MB)\n", (int)store.Size(),
+	       Frame::FormatName(store.Format()),
+	       store.MemoryUsage() / (1024.0 * 1024.0));
 
+	int height = store.Height();
 	if (settings.do_crop) {
 		if (settings.crop_pixels < 0 ||
 		    settings.crop_pixels >= height) {
@@ -270,79 +336,121 @@ bool loadImages(const Settings &settings, std::vector<uint32_t *> &images,
 			       height - 1);
 			return false;
 		}
-		height -= settings.crop_pixels;
+		// cropping the bottom is just a view of the top rows
+		for (auto &image : store.Frames()) {
+			image.data = image.data.rowRange(
+			    0, height - settings.crop_pixels);
+		}
 	}
 
 	return true;
 }
 
-// Apply denoising based on settings
-void applyDenoising(const Settings &settings, std::vector<uint32_t *> &images,
-		    int width, int height) {
+// Apply denoising based on settings, `model` is the loaded filter model (see
+// loadDenoiseModel)
+void applyDenoising(const Settings &settings, DenoiseInterface::Model *model,
+		    std::vector<Frame> &images) {
 	TileConfig config =
 	    TileConfig(TileType::Cropped, settings.denoise_tile_size,
 		       settings.denoise_overlap, settings.denoise_center_size,
 		       settings.includeOutside);
 	if (settings.do_denoise) {
 		if (settings.filter == "blur") {
-			DenoiseInterface::Blur(images, width, height, 3, 1.0f);
-		} else {
-			DenoiseInterface::Denoise(images, width, height,
-						  settings.filter, config);
+			DenoiseInterface::Blur(images, 3, 1.0f);
+		} else if (model) {
+			DenoiseInterface::Denoise(images, *model, config);
 		}
 	}
 }
 
+// The model of the denoising filter, loaded once for all batches. nullptr if
+// there's nothing to load or it failed
+std::shared_ptr<DenoiseInterface::Model>
+loadDenoiseModel(const Settings &settings) {
+	if (!settings.do_denoise || settings.filter == "blur") {
+		return nullptr;
+	}
+	auto model = DenoiseInterface::LoadModel(settings.filter);
+	if (!model) {
+		printf("Failed to load the %s model, skipping denoising\n",
+		       settings.filter.c_str());
+	}
+	return model;
+}
+
+// Results of the analysis stages, collected over all batches
+struct Results {
+	std::vector<std::vector<float>> histograms;
+	std::vector<float> snrs;
+	std::vector<std::vector<std::vector<cv::Point>>> polygons;
+};
+
 // Perform image analysis based on settings
-void performAnalysis(const Settings &settings, std::vector<uint32_t *> &images,
-		     int width, int height) {
+void performAnalysis(const Settings &settings, std::vector<Frame> &images,
+		     Results &results) {
 	if (settings.do_analyze) {
-		std::vector<std::vector<float>> histograms;
+		// the averages are computed over the whole sequence at the end
 		std::vector<float> avg_histogram;
-		std::vector<float> snrs;
-		float avg_snr;
-
-		ImageAnalysis::AnalyzeImages(images, width, height, histograms,
-					     avg_histogram, snrs, avg_snr);
-		io::SaveAnalysisCsv(settings.stats_output.c_str(), histograms,
-				    avg_histogram, snrs, avg_snr);
+		float avg_snr = 0.0f;
+		ImageAnalysis::AnalyzeImages(images, results.histograms,
+					     avg_histogram, results.snrs,
+					     avg_snr);
 	}
 }
 
-// Calculate crack widths based on settings
-void calculateWidths(const Settings &settings, std::vector<uint32_t *> &images,
-		     int width, int height) {
+// Calculate crack widths based on settings, draws the cracks into the frames
+void calculateWidths(const Settings &settings, std::vector<Frame> &images,
+		     Results &results) {
 	if (settings.do_widths) {
-		auto polygons =
-		    CrackDetector::DetectCracks(images, width, height);
-		auto widths = FeatureTracker::TrackCrackWidthProfiles(polygons);
-		io::WriteCSV(settings.widths_output.c_str(), widths);
+		auto polygons = CrackDetector::DetectCracks(images);
+		results.polygons.insert(results.polygons.end(),
+					polygons.begin(), polygons.end());
 	}
 }
 
-// Save output images if output path provided
-void saveOutputImages(const Settings &settings, std::vector<uint32_t *> &images,
-		      int width, int height) {
-	if (!settings.output.empty()) {
-		printf("Saving images to %s\n", settings.output.c_str());
-
-		std::string outputPath = settings.output;
-		// Remove trailing slash if present
-		if (outputPath.back() == '/') {
-			outputPath.pop_back();
+// Write the analysis outputs once every frame has been through the stages
+void saveResults(const Settings &settings, Results &results) {
+	if (settings.do_analyze && !results.histograms.empty()) {
+		std::vector<float> avg_histogram(results.histograms[0].size());
+		float avg_snr = 0.0f;
+		for (size_t i = 0; i < results.histograms.size(); i++) {
+			for (size_t j = 0; j < avg_histogram.size(); j++) {
+				avg_histogram[j] += results.histograms[i][j];
+			}
+			avg_snr += results.snrs[i];
 		}
-
-		if (!std::filesystem::exists(outputPath)) {
-			std::filesystem::create_directory(outputPath);
+		for (auto &bin : avg_histogram) {
+			bin /= results.histograms.size();
 		}
+		avg_snr /= results.histograms.size();
 
-		for (int i = 0; i < images.size(); i++) {
-			char filename[256];
-			sprintf(filename, "%s/image_%d.tif", outputPath.c_str(),
-				i);
-			io::WriteTiff(filename, images[i], width, height);
-		}
+		io::SaveAnalysis(settings.stats_output.c_str(),
+				 results.histograms, avg_histogram,
+				 results.snrs, avg_snr);
 	}
+	if (settings.do_widths) {
+		auto widths =
+		    FeatureTracker::TrackCrackWidthProfiles(results.polygons);
+		io::WriteWidths(settings.widths_output.c_str(), widths);
+	}
+}
+
+// Writer for the output images if an output path was provided, frames are
+// saved in their own format. A .tif/.tiff output is written as one
+// multi-page stack, anything else is a folder with a file per frame.
+std::unique_ptr<io::TiffSequenceWriter> createOutputWriter(
+    const Settings &settings, int count) {
+	if (settings.output.empty()) {
+		return nullptr;
+	}
+	printf("Saving images to %s\n", settings.output.c_str());
+
+	std::string extension =
+	    std::filesystem::path(settings.output).extension().string();
+	bool stack = extension == ".tif" || extension == ".tiff";
+	return std::make_unique<io::TiffSequenceWriter>(
+	    settings.output, count, settings.tiff_options,
+	    stack ? nullptr : "image_%d.tif");
 }
 
 // Main CLI entry point
@@ -364,17 +472,47 @@ void run(int argc, char **argv) {
 	}
 
 	// Load images
-	std::vector<uint32_t *> images;
-	int width, height;
-	if (!loadImages(settings, images, width, height)) {
+	// the cache has to outlive the store, its frames may be views into it
+	FrameCache cache;
+	FrameStore store;
+	if (!loadImages(settings, cache, store)) {
 		return;
 	}
+	std::vector<Frame> &images = store.Frames();
+
+	// The frames go through the stages a batch at a time and every batch is
+	// handed to the writer as soon as its last stage is done, so the output
+	// is written in the background while the next batch is processed. The
+	// batches are big enough to keep the pool busy, the denoising model is
+	// loaded once for all of them.
+	auto writer = createOutputWriter(settings, (int)images.size());
+	auto model = loadDenoiseModel(settings);
+	Results results;
+	const size_t batch_size = std::max<size_t>(
+	    16, ThreadPool::GetThreadPool().get_thread_count() * 2);
+	for (size_t first = 0; first < images.size(); first += batch_size) {
+		size_t last = std::min(images.size(), first + batch_size);
+		// views, the stages work on the store's pixels
+		std::vector<Frame> batch(images.begin() + first,
+					 images.begin() + last);
+
+		applyDenoising(settings, model.get(), batch);
+		performAnalysis(settings, batch, results);
+		calculateWidths(settings, batch, results);
+
+		if (writer) {
+			for (size_t i = 0; i < batch.size(); i++) {
+				writer->Write((int)(first + i), batch[i]);
+			}
+		}
+	}
+	saveResults(settings, results);
 
-	// Apply image processing operations
-	applyDenoising(settings, images, width, height);
-	performAnalysis(settings, images, width, height);
-	calculateWidths(settings, images, width, height);
-	saveOutputImages(settings, images, width, height);
+	// waits for the queued frames and syncs them to disk
+	if (writer && !writer->Finish()) {
+		printf("Failed to save the images to %s\n",
+		       settings.output.c_str());
+	}
 
 	// Check if any operations were performed
 	if (!settings.do_crop && !settings.do_denoise && !settings.do_analyze &&
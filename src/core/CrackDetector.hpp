@@ -7,29 +7,45 @@
 
 #include <opencv2/opencv.hpp>
 
+#include <core/Frame.hpp>
+#include <core/Job.hpp>
+
 class CrackDetector {
       public:
+	// frames not yet started when the job is cancelled are skipped and
+	// keep an empty polygon list
 	static std::vector<std::vector<std::vector<cv::Point>>>
 	DetectCracks(const std::vector<uint32_t *> &images, int width,
 		     int height, int crack_darkness = 40,
 		     int fill_threshold = 2, int sharpness = 50,
-		     int resolution = 3, int amount = 1);
-	static std::future<bool>
-	DetectCracksAsync(const std::vector<uint32_t *> &images, int width,
-			  int height, int crack_darkness = 40,
-			  int fill_threshold = 2, int sharpness = 50,
-			  int resolution = 3, int amount = 1,
-			  std::function<void(bool)> callback = nullptr);
-	static std::future<std::vector<std::vector<std::vector<cv::Point>>>>
-	DetectCracksDataAsync(const std::vector<uint32_t *> &images, int width,
-			      int height, int crack_darkness = 40,
-			      int fill_threshold = 2, int sharpness = 50,
-			      int resolution = 3, int amount = 1);
-
-	static bool IsProcessing() { return m_is_processing; }
-	static float GetProgress() { return m_progress; }
+		     int resolution = 3, int amount = 1,
+		     const Job &job = Job());
+	// any frame format, the outlines are drawn into the frames
+	static std::vector<std::vector<std::vector<cv::Point>>>
+	DetectCracks(std::vector<Frame> &images, int crack_darkness = 40,
+		     int fill_threshold = 2, int sharpness = 50,
+		     int resolution = 3, int amount = 1,
+		     const Job &job = Job());
+	// the job fails if it was cancelled, the images have to stay alive
+	// until it finished
+	static Job DetectCracksAsync(const std::vector<uint32_t *> &images,
+				     int width, int height,
+				     int crack_darkness = 40,
+				     int fill_threshold = 2, int sharpness = 50,
+				     int resolution = 3, int amount = 1,
+				     std::function<void(bool)> callback = nullptr);
+	// same, the polygons of every frame are written to `polygons`
+	static Job DetectCracksDataAsync(
+	    const std::vector<uint32_t *> &images, int width, int height,
+	    std::vector<std::vector<std::vector<cv::Point>>> &polygons,
+	    int crack_darkness = 40, int fill_threshold = 2,
+	    int sharpness = 50, int resolution = 3, int amount = 1,
+	    std::function<void(bool)> callback = nullptr);
 
       private:
-	static bool m_is_processing;
-	static float m_progress;
+	// detects the cracks of one frame and draws them into it
+	static std::vector<std::vector<cv::Point>>
+	DetectCracksInFrame(Frame &frame, int crack_darkness,
+			    int fill_threshold, int sharpness,
+			    int resolution, int amount);
 };
@@ -16,21 +16,29 @@
 #include <torch/script.h>
 #include <torch/torch.h>
 
-bool DeformationAnalysisInterface::m_processing = false;
-float DeformationAnalysisInterface::m_progress = 0.0f;
+#ifdef UI_INCLUDE_PYTORCH
+// Packs tiles [first, first + count) of two frames into one float batch of
+// shape (count, 2, tileSize, tileSize), the only copy the tiles get
+static torch::Tensor PackTilePairs(const TilePlan &plan1, const TilePlan &plan2, size_t first, size_t count) {
+	int tile_size = plan1.tileSize;
+	auto batch = torch::empty({(int64_t)count, 2, tile_size, tile_size}, torch::kUInt8);
+	uint8_t *data = batch.data_ptr<uint8_t>();
+	size_t tile_bytes = (size_t)tile_size * tile_size;
+	for (size_t j = 0; j < count; ++j) {
+		plan1.Pack(first + j, data + (2 * j) * tile_bytes);
+		plan2.Pack(first + j, data + (2 * j + 1) * tile_bytes);
+	}
+	return batch.to(torch::kFloat32);
+}
+#endif
 
 bool DeformationAnalysisInterface::RunModel(std::vector<uint32_t *> &images, int width, int height,
-					    std::vector<Tile> &output_tiles, const TileConfig &tile_config) {
+					    std::vector<Tile> &output_tiles, const TileConfig &tile_config,
+					    const Job &job) {
 	PROFILE_FUNCTION();
 
-	m_processing = true;
-	m_progress = 0.0f;
-
 #ifdef UI_INCLUDE_PYTORCH
-	auto to_tensor = [](const cv::Mat &m) {
-		return torch::from_blob(m.data, {1, 1, 256, 256}, torch::kUInt8).to(torch::kFloat32).clone();
-	};
-
+	job.SetStage("Loading model");
 	auto dev = torch::cuda::is_available() ? torch::kCUDA : torch::kCPU;
 	// input: 2 images, each 256x256 and need to be converted to 1x256x256
 	// (1 channel) input: data format: float between [0, 255] output: 2
@@ -42,27 +50,34 @@ bool DeformationAnalysisInterface::RunModel(std::vector<uint32_t *> &images, int
 
 	// Make sure we have at least 2 images to process
 	if (images.size() < 2) {
-		m_progress = 1.0f;
-		m_processing = false;
 		return false;
 	}
 
+	job.SetStage("Running model");
 	for (size_t i = 0; i < images.size() - 1; ++i) {
+		if (job.IsCancelled()) {
+			return false;
+		}
+
 		// Update progress
-		m_progress = (float)i / std::max(1, (int)images.size() - 1);
+		job.SetProgress((float)i / std::max(1, (int)images.size() - 1));
 
 		// === INPUT FORMATTING ===
 		cv::Mat image = cv::Mat(height, width, CV_8UC4, images[i]);
 		cv::cvtColor(image, image, cv::COLOR_BGRA2GRAY);
-		auto tiles = Tiler::CreateTiles(image, tile_config);
+		TilePlan plan = Tiler::PlanTiles(image, tile_config);
 		cv::Mat image2 = cv::Mat(height, width, CV_8UC4, images[i + 1]);
 		cv::cvtColor(image2, image2, cv::COLOR_BGRA2GRAY);
-		auto tiles2 = Tiler::CreateTiles(image2, tile_config);
+		TilePlan plan2 = Tiler::PlanTiles(image2, tile_config);
 
 		std::vector<Tile> outTiles;
-		for (int k = 0; k < tiles.size(); ++k) {
+		for (size_t k = 0; k < plan.Size(); ++k) {
+			if (job.IsCancelled()) {
+				return false;
+			}
+
 			// === MODEL INFERENCE ===
-			auto input = torch::cat({to_tensor(tiles[k].data), to_tensor(tiles2[k].data)}, 1).to(dev);
+			auto input = PackTilePairs(plan, plan2, k, 1).to(dev);
 
 			auto out = model.forward({input}).toTensor().to(torch::kCPU); // out: torch::Tensor on cpu,
 										      // shape 1,2,H,W
@@ -103,9 +118,9 @@ bool DeformationAnalysisInterface::RunModel(std::vector<uint32_t *> &images, int
 				  bgr); // b=0, g=chan1, r=chan0
 					// convert to BGRA (add alpha channel)
 			cv::cvtColor(bgr, bgr, cv::COLOR_BGR2BGRA);
-			outTiles.push_back({bgr.clone(), tiles[k].position}); // own memory
+			outTiles.push_back({bgr.clone(), plan.Position(k)}); // own memory
 			output_tiles.push_back(
-			    {bgr.clone(), tiles[k].position, (int)i}); // own memory with source frame index
+			    {bgr.clone(), plan.Position(k), (int)i}); // own memory with source frame index
 		}
 		auto stitched = Tiler::StitchTiles(outTiles, tile_config, image.size());
 
@@ -113,93 +128,77 @@ bool DeformationAnalysisInterface::RunModel(std::vector<uint32_t *> &images, int
 		memcpy(images[i], stitched.data, width * height * sizeof(uint32_t));
 	}
 
-	m_progress = 1.0f;
-	m_processing = false;
+	job.SetProgress(1.0f);
 	return true;
 #else  // UI_INCLUDE_PYTORCH
-	m_processing = false;
 	return false;
 #endif // UI_INCLUDE_PYTORCH
 }
 
 // Asynchronous version of the model execution
-std::future<bool> DeformationAnalysisInterface::RunModelAsync(std::vector<uint32_t *> &images, int width, int height,
-							      std::vector<Tile> &tiles, const TileConfig &tile_config,
-							      std::function<void(bool)> callback) {
-
-	m_processing = true;
-	m_progress = 0.0f;
-
-	// Creates a task that will be run asynchronously - we capture images by value (as a copy)
-	auto task = [=]() mutable {
-		bool result = RunModel(images, width, height, tiles, tile_config);
-		callback(result);
-		return result;
-	};
-
-	return std::async(std::launch::async, task);
+Job DeformationAnalysisInterface::RunModelAsync(std::vector<uint32_t *> &images, int width, int height,
+						std::vector<Tile> &tiles, const TileConfig &tile_config,
+						std::function<void(bool)> callback) {
+	return Job::Run(
+	    TaskPriority::Batch,
+	    [&images, width, height, &tiles, tile_config](Job &job) {
+		    return RunModel(images, width, height, tiles, tile_config, job);
+	    },
+	    callback);
 }
 
 bool DeformationAnalysisInterface::RunModelBatch(std::vector<uint32_t *> &images, int width, int height,
 						 std::vector<Tile> &output_tiles, const TileConfig &tile_config,
-						 const int batch_size) // ← new adjustable batch size
-{
+						 const int batch_size, // ← new adjustable batch size
+						 const Job &job) {
 	PROFILE_FUNCTION();
 
-	m_processing = true;
-	m_progress = 0.0f;
-
 #ifdef UI_INCLUDE_PYTORCH
-	auto to_tensor = [](const cv::Mat &m) {
-		return torch::from_blob(m.data, {1, 1, 256, 256}, torch::kUInt8).to(torch::kFloat32).clone();
-	};
 	auto to_u8 = [&](torch::Tensor x) { return x.add(2.0).div(4.0).mul(255).clamp(0, 255).to(torch::kUInt8); };
 
+	job.SetStage("Loading model");
 	auto dev = torch::cuda::is_available() ? torch::kCUDA : torch::kCPU;
 	auto model = torch::jit::load("assets/models/batch-m4-combo.pt");
 	model.to(dev);
 	model.eval();
 
 	if (images.size() < 2) {
-		m_progress = 1.0f;
-		m_processing = false;
 		return false;
 	}
 
+	job.SetStage("Running model");
 	for (size_t i = 0; i < images.size() - 1; ++i) {
 		PROFILE_SCOPE(DeformationOneFrame);
 
-		m_progress = float(i) / float(images.size() - 1);
+		if (job.IsCancelled()) {
+			return false;
+		}
+
+		job.SetProgress(float(i) / float(images.size() - 1));
 
 		// prepare grayscale tiles for frame i and i+1
 		cv::Mat img1(height, width, CV_8UC4, images[i]);
 		cv::cvtColor(img1, img1, cv::COLOR_BGRA2GRAY);
-		auto tiles1 = Tiler::CreateTiles(img1, tile_config);
+		TilePlan plan1 = Tiler::PlanTiles(img1, tile_config);
 
 		cv::Mat img2(height, width, CV_8UC4, images[i + 1]);
 		cv::cvtColor(img2, img2, cv::COLOR_BGRA2GRAY);
-		auto tiles2 = Tiler::CreateTiles(img2, tile_config);
+		TilePlan plan2 = Tiler::PlanTiles(img2, tile_config);
 
 		std::vector<Tile> outTiles;
-		size_t total = tiles1.size();
+		size_t total = plan1.Size();
 
 		for (size_t k = 0; k < total; k += batch_size) {
 			PROFILE_SCOPE(BatchProcessing);
 
-			size_t curr_batch = std::min((size_t)batch_size, total - k);
-
-			// build batch of tensors
-			std::vector<torch::Tensor> batch_inputs;
-			batch_inputs.reserve(curr_batch);
-			for (size_t j = 0; j < curr_batch; ++j) {
-				auto t0 = to_tensor(tiles1[k + j].data);
-				auto t1 = to_tensor(tiles2[k + j].data);
-				batch_inputs.push_back(torch::cat({t0, t1}, 1));
+			if (job.IsCancelled()) {
+				return false;
 			}
 
-			auto raw = torch::stack(batch_inputs, 0);
-			auto squeezed = raw.squeeze(1);			  // shape (B,2,H,W)
-			auto input_batch = squeezed.contiguous().to(dev); // shape (B,2,H,W)
+			size_t curr_batch = std::min((size_t)batch_size, total - k);
+
+			// the tiles are packed straight into the batch
+			auto input_batch = PackTilePairs(plan1, plan2, k, curr_batch).to(dev); // shape (B,2,H,W)
 
 			// single forward for the whole batch
 			auto out_batch = model.forward({input_batch}).toTensor().to(torch::kCPU); // shape (B,2,H,W)
@@ -225,8 +224,8 @@ bool DeformationAnalysisInterface::RunModelBatch(std::vector<uint32_t *> &images
 				cv::merge(chans, bgr);
 				cv::cvtColor(bgr, bgr, cv::COLOR_BGR2BGRA);
 
-				outTiles.push_back({bgr.clone(), tiles1[k + j].position});
-				output_tiles.push_back({bgr.clone(), tiles1[k + j].position, (int)i});
+				outTiles.push_back({bgr.clone(), plan1.Position(k + j)});
+				output_tiles.push_back({bgr.clone(), plan1.Position(k + j), (int)i});
 			}
 		}
 
@@ -234,39 +233,20 @@ bool DeformationAnalysisInterface::RunModelBatch(std::vector<uint32_t *> &images
 		memcpy(images[i], stitched.data, width * height * sizeof(uint32_t));
 	}
 
-	m_progress = 1.0f;
-	m_processing = false;
+	job.SetProgress(1.0f);
 	return true;
 #else
-	m_processing = false;
 	return false;
 #endif
 }
 
-std::future<bool> DeformationAnalysisInterface::RunModelBatchAsync(std::vector<uint32_t *> &images, int width,
-								   int height, std::vector<Tile> &output_tiles,
-								   const TileConfig &tile_config, const int batch_size,
-								   std::function<void(bool)> callback) {
-	// Set processing flag
-	m_processing = true;
-	m_progress = 0.0f;
-
-	// Get the thread pool
-	auto &pool = ThreadPool::GetThreadPool();
-
-	// Submit task to thread pool
-	auto future = pool.enqueue([&images, width, height, &output_tiles, tile_config, batch_size, callback]() {
-		bool result = RunModelBatch(images, width, height, output_tiles, tile_config, batch_size);
-
-		// When complete, update processing flag and call callback
-		// if provided
-		m_processing = false;
-		if (callback) {
-			callback(result);
-		}
-
-		return result;
-	});
-
-	return future;
+Job DeformationAnalysisInterface::RunModelBatchAsync(std::vector<uint32_t *> &images, int width, int height,
+						     std::vector<Tile> &output_tiles, const TileConfig &tile_config,
+						     const int batch_size, std::function<void(bool)> callback) {
+	return Job::Run(
+	    TaskPriority::Batch,
+	    [&images, width, height, &output_tiles, tile_config, batch_size](Job &job) {
+		    return RunModelBatch(images, width, height, output_tiles, tile_config, batch_size, job);
+	    },
+	    callback);
 }
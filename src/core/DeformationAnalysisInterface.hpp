@@ -5,34 +5,28 @@
 #include <future>
 #include <vector>
 
+#include <core/Job.hpp>
 #include <utils.h>
 
 #include <opencv2/opencv.hpp>
 
 class DeformationAnalysisInterface {
       public:
-	// Synchronous model execution
+	// Synchronous model execution, the job is checked for cancellation
+	// between frame pairs and tile batches. Returns false when cancelled.
 	static bool RunModel(std::vector<uint32_t *> &images, int width, int height, std::vector<Tile> &tiles,
-			     const TileConfig &tile_config);
+			     const TileConfig &tile_config, const Job &job = Job());
 
-	// Asynchronous model execution with callback
-	static std::future<bool> RunModelAsync(
-	    std::vector<uint32_t *> &images, int width, int height, std::vector<Tile> &tiles,
-	    const TileConfig &tile_config, std::function<void(bool)> callback = [](bool) {});
+	// Asynchronous model execution with callback, the images and tiles have
+	// to stay alive until the job finished
+	static Job RunModelAsync(std::vector<uint32_t *> &images, int width, int height, std::vector<Tile> &tiles,
+				 const TileConfig &tile_config, std::function<void(bool)> callback = nullptr);
 
 	static bool RunModelBatch(std::vector<uint32_t *> &images, int width, int height,
 			    std::vector<Tile> &output_tiles, const TileConfig &tile_config,
-			    const int batch_size = 1);
+			    const int batch_size = 1, const Job &job = Job());
 
-	static std::future<bool> RunModelBatchAsync(
-	    std::vector<uint32_t *> &images, int width, int height, std::vector<Tile> &output_tiles,
-	    const TileConfig &tile_config, const int batch_size = 1,
-	    std::function<void(bool)> callback = [](bool) {});
-
-	static bool IsProcessing() { return m_processing; }
-	static float GetProgress() { return m_progress; }
-
-      private:
-	static bool m_processing;
-	static float m_progress;
+	static Job RunModelBatchAsync(std::vector<uint32_t *> &images, int width, int height,
+				      std::vector<Tile> &output_tiles, const TileConfig &tile_config,
+				      const int batch_size = 1, std::function<void(bool)> callback = nullptr);
 };
@@ -9,41 +9,77 @@
 
 #include <opencv2/opencv.hpp>
 
-// Static member initialization
-float DenoiseInterface::m_progress = 0.0f;
-bool DenoiseInterface::m_is_processing = false;
-
-// Original synchronous implementation
 bool DenoiseInterface::Denoise(std::vector<uint32_t *> &images, int width, int height, const std::string &model_name,
-			       const TileConfig &config) {
+			       const TileConfig &config, const Job &job) {
+	auto frames = Frame::WrapBGRA(images, width, height);
+	return Denoise(frames, model_name, config, job);
+}
+
+struct DenoiseInterface::Model {
+#ifdef UI_INCLUDE_TENSORFLOW
+	cppflow::model model;
+#endif
+};
+
+std::shared_ptr<DenoiseInterface::Model> DenoiseInterface::LoadModel(const std::string &model_name) {
+	PROFILE_FUNCTION();
+
+#ifdef UI_INCLUDE_TENSORFLOW
+	try {
+		return std::make_shared<Model>(Model{cppflow::model("assets/models/tk_r_em/" + model_name)});
+	} catch (const std::runtime_error &e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return nullptr;
+	}
+#else
+	printf("Denoising not available, recompile/use other executable with "
+	       "TensorFlow support\n");
+	return nullptr;
+#endif
+}
+
+bool DenoiseInterface::Denoise(std::vector<Frame> &images, const std::string &model_name, const TileConfig &config,
+			       const Job &job) {
+	job.SetStage("Loading model");
+	std::shared_ptr<Model> model = LoadModel(model_name);
+	return model && Denoise(images, *model, config, job);
+}
+
+bool DenoiseInterface::Denoise(std::vector<Frame> &images, Model &model, const TileConfig &config, const Job &job) {
 	PROFILE_FUNCTION();
 
 #ifdef UI_INCLUDE_TENSORFLOW
-	cppflow::model model("assets/models/tk_r_em/" + model_name);
+	job.SetStage("Denoising");
 
 	for (int i = 0; i < images.size(); i++) {
 		PROFILE_SCOPE(DenoiseOneImage);
 
-		m_progress = (float)i / images.size();
+		if (job.IsCancelled()) {
+			return false;
+		}
+
+		job.SetProgress((float)i / images.size());
 
-		cv::Mat image = cv::Mat(height, width, CV_8UC4, images[i]);
-		cv::cvtColor(image, image, cv::COLOR_BGRA2GRAY);
-		image.convertTo(image, CV_32FC1, 1.0 / 255.0);
-		cv::Size paddedSize;
-		auto tiles = Tiler::CreateTiles(image, config);
+		// the model works on float gray in [0, 1], whatever the frame holds
+		cv::Mat image = images[i].ToGray32F();
+		TilePlan plan = Tiler::PlanTiles(image, config);
+		int tile_size = plan.tileSize;
 
+		// every tile is packed straight into the model's input, the only
+		// copy of it that's made
 		std::vector<cppflow::tensor> output;
-		for (auto &tile : tiles) {
-			std::vector<float> image_data;
-			for (int y = 0; y < tile.data.rows; y++)
-				for (int x = 0; x < tile.data.cols; x++)
-					image_data.push_back(tile.data.at<float>(y, x));
+		std::vector<float> image_data(tile_size * tile_size);
+		for (size_t k = 0; k < plan.Size(); k++) {
+			if (job.IsCancelled()) {
+				return false;
+			}
 
-			cppflow::tensor input = cppflow::tensor(image_data, {1, tile.data.rows, tile.data.cols, 1});
+			plan.Pack(k, image_data.data());
+			cppflow::tensor input = cppflow::tensor(image_data, {1, tile_size, tile_size, 1});
 
 			try {
 				auto output2 =
-				    model({{"serving_default_input_gen", input}}, {"StatefulPartitionedCall"});
+				    model.model({{"serving_default_input_gen", input}}, {"StatefulPartitionedCall"});
 				output.push_back(output2[0]);
 			} catch (const std::runtime_error &e) {
 				std::cerr << "Error: " << e.what() << std::endl;
@@ -52,98 +88,77 @@ bool DenoiseInterface::Denoise(std::vector<uint32_t *> &images, int width, int h
 		}
 
 		// convert tensors to cv::Mat and recombine
-		for (int j = 0; j < tiles.size(); j++) {
+		std::vector<Tile> tiles(plan.Size());
+		for (size_t j = 0; j < plan.Size(); j++) {
 			auto output_data = output[j].get_data<float>();
-			cv::Mat output_image(tiles[j].data.size(), CV_32FC1);
-			for (int y = 0; y < tiles[j].data.rows; y++) {
-				for (int x = 0; x < tiles[j].data.cols; x++) {
-					output_image.at<float>(y, x) = output_data[y * tiles[j].data.cols + x];
+			cv::Mat output_image(tile_size, tile_size, CV_32FC1);
+			for (int y = 0; y < tile_size; y++) {
+				for (int x = 0; x < tile_size; x++) {
+					output_image.at<float>(y, x) = output_data[y * tile_size + x];
 				}
 			}
-			tiles[j].data = output_image;
+			tiles[j] = {output_image, plan.Position(j)};
 		}
 
+		// back into the frame's own format
 		cv::Mat reconstructed = Tiler::StitchTiles(tiles, config, image.size());
-		memcpy(images[i], reconstructed.data, width * height * 4);
+		images[i].Assign(reconstructed);
 	}
 
-	m_progress = 1.0f;
+	job.SetProgress(1.0f);
 	return true;
 #else
-	printf("Denoising not available, recompile/use other executable with "
-	       "TensorFlow support\n");
+	// there's no model to load without TensorFlow, LoadModel said so
 	return false;
 #endif
 }
 
 // Asynchronous version of Denoise
-std::future<bool> DenoiseInterface::DenoiseAsync(std::vector<uint32_t *> &images, int width, int height,
-						 const std::string &model_name, const TileConfig &config,
-						 std::function<void(bool)> callback) {
-	// Set processing flag
-	m_is_processing = true;
-	m_progress = 0.0f;
-
-	// Get the thread pool
-	auto &pool = ThreadPool::GetThreadPool();
-
-	// Submit task to thread pool
-	auto future = pool.enqueue([&images, width, height, model_name, config, callback]() {
-		bool result = Denoise(images, width, height, model_name, config);
-
-		// When complete, update processing flag and call callback
-		// if provided
-		m_is_processing = false;
-		if (callback) {
-			callback(result);
-		}
-
-		return result;
-	});
+Job DenoiseInterface::DenoiseAsync(std::vector<uint32_t *> &images, int width, int height,
+				   const std::string &model_name, const TileConfig &config,
+				   std::function<void(bool)> callback) {
+	return Job::Run(
+	    TaskPriority::Batch,
+	    [&images, width, height, model_name, config](Job &job) {
+		    return Denoise(images, width, height, model_name, config, job);
+	    },
+	    callback);
+}
 
-	return future;
+bool DenoiseInterface::Blur(std::vector<uint32_t *> &images, int width, int height, int kernel_size, float sigma,
+			    const Job &job) {
+	auto frames = Frame::WrapBGRA(images, width, height);
+	return Blur(frames, kernel_size, sigma, job);
 }
 
-bool DenoiseInterface::Blur(std::vector<uint32_t *> &images, int width, int height, int kernel_size, float sigma) {
+bool DenoiseInterface::Blur(std::vector<Frame> &images, int kernel_size, float sigma, const Job &job) {
 	PROFILE_FUNCTION();
 
+	job.SetStage("Blurring");
 	for (int i = 0; i < images.size(); i++) {
-		m_progress = (float)i / images.size();
+		if (job.IsCancelled()) {
+			return false;
+		}
 
-		cv::Mat image(height, width, CV_8UC4, images[i]);
+		job.SetProgress((float)i / images.size());
+
+		// blurs in the frame's own format
 		cv::Mat output_image;
-		cv::GaussianBlur(image, output_image, cv::Size(kernel_size, kernel_size), sigma);
-		output_image.copyTo(image);
-		memcpy(images[i], image.data, width * height * 4);
+		cv::GaussianBlur(images[i].data, output_image, cv::Size(kernel_size, kernel_size), sigma);
+		output_image.copyTo(images[i].data);
 	}
 
-	m_progress = 1.0f;
+	job.SetProgress(1.0f);
 	return true;
 }
 
 // Asynchronous version of Blur
-std::future<bool> DenoiseInterface::BlurAsync(std::vector<uint32_t *> &images, int width, int height, int kernel_size,
-					      float sigma, std::function<void(bool)> callback) {
-	// Set processing flag
-	m_is_processing = true;
-	m_progress = 0.0f;
-
-	// Get the thread pool
-	auto &pool = ThreadPool::GetThreadPool();
-
-	// Submit task to thread pool
-	auto future = pool.enqueue([&images, width, height, kernel_size, sigma, callback]() {
-		bool result = Blur(images, width, height, kernel_size, sigma);
-
-		// When complete, update processing flag and call callback if
-		// provided
-		m_is_processing = false;
-		if (callback) {
-			callback(result);
-		}
-
-		return result;
-	});
-
-	return future;
+Job DenoiseInterface::BlurAsync(std::vector<uint32_t *> &images, int width, int height, int kernel_size, float sigma,
+				std::function<void(bool)> callback) {
+	return Job::Run(
+	    TaskPriority::Batch,
+	    [&images, width, height, kernel_size, sigma](Job &job) {
+		    return Blur(images, width, height, kernel_size, sigma, job);
+	    },
+	    callback);
 }
@@ -3,36 +3,52 @@
 #include <cstdint>
 #include <functional>
 #include <future>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <OpenGL/Texture.h>
+#include <core/Frame.hpp>
+#include <core/Job.hpp>
 #include <core/Tiler.hpp>
 
 class DenoiseInterface {
       public:
-	// Synchronous methods
+	// A loaded denoising model. Loading takes a while, so a sequence that's
+	// denoised in several calls (e.g. in batches) loads it once
+	struct Model;
+	// nullptr if the model can't be loaded or TensorFlow isn't compiled in
+	static std::shared_ptr<Model> LoadModel(const std::string &model_name);
+
+	// Synchronous methods, return false if they failed or the job was
+	// cancelled (checked between frames and tiles). Progress goes to the job
 	static bool Denoise(std::vector<uint32_t *> &images, int width,
 			    int height, const std::string &model_name,
-			    const TileConfig &config);
+			    const TileConfig &config,
+			    const Job &job = Job());
 	static bool Blur(std::vector<uint32_t *> &images, int width, int height,
-			 int kernel_size, float sigma);
-
-	// Asynchronous methods with callback
-	static std::future<bool>
-	DenoiseAsync(std::vector<uint32_t *> &images, int width, int height,
-		     const std::string &model_name, const TileConfig &config,
-		     std::function<void(bool)> callback = nullptr);
-	static std::future<bool>
-	BlurAsync(std::vector<uint32_t *> &images, int width, int height,
-		  int kernel_size, float sigma,
-		  std::function<void(bool)> callback = nullptr);
+			 int kernel_size, float sigma,
+			 const Job &job = Job());
 
-	// Status checking
-	static bool IsProcessing() { return m_is_processing; }
-	static float GetProgress() { return m_progress; }
+	// Frame versions, the result keeps each frame's format
+	static bool Denoise(std::vector<Frame> &images,
+			    const std::string &model_name,
+			    const TileConfig &config,
+			    const Job &job = Job());
+	static bool Denoise(std::vector<Frame> &images, Model &model,
+			    const TileConfig &config,
+			    const Job &job = Job());
+	static bool Blur(std::vector<Frame> &images, int kernel_size,
+			 float sigma,
+			 const Job &job = Job());
 
-      private:
-	static float m_progress;
-	static bool m_is_processing;
+	// Asynchronous methods with callback, queued as batch work. The images
+	// have to stay alive until the job finished
+	static Job DenoiseAsync(std::vector<uint32_t *> &images, int width,
+				int height, const std::string &model_name,
+				const TileConfig &config,
+				std::function<void(bool)> callback = nullptr);
+	static Job BlurAsync(std::vector<uint32_t *> &images, int width,
+			     int height, int kernel_size, float sigma,
+			     std::function<void(bool)> callback = nullptr);
 };
@@ -0,0 +1,100 @@
+#include <core/Frame.hpp>
+
+// largest intensity of a channel depth, used to rescale between formats
+static double MaxValue(int depth) {
+	switch (depth) {
+	case CV_8U:
+		return 255.0;
+	case CV_16U:
+		return 65535.0;
+	default:
+		return 1.0;
+	}
+}
+
+std::vector<Frame> Frame::WrapBGRA(const std::vector<uint32_t *> &pixels, int width, int height) {
+	std::vector<Frame> frames;
+	frames.reserve(pixels.size());
+	for (auto ptr : pixels) {
+		frames.push_back(WrapBGRA(ptr, width, height));
+	}
+	return frames;
+}
+
+PixelFormat Frame::Format() const {
+	switch (data.type()) {
+	case CV_16UC1:
+		return PixelFormat::Gray16;
+	case CV_32FC1:
+		return PixelFormat::Gray32F;
+	case CV_8UC4:
+		return PixelFormat::BGRA8;
+	default:
+		return PixelFormat::Gray8;
+	}
+}
+
+cv::Mat Frame::Converted(PixelFormat format) const {
+	if (data.type() == CvType(format)) {
+		return data;
+	}
+	cv::Mat out;
+	Convert(data, out, format);
+	return out;
+}
+
+void Frame::Assign(const cv::Mat &image) { Convert(image, data, Format()); }
+
+int Frame::CvType(PixelFormat format) {
+	switch (format) {
+	case PixelFormat::Gray8:
+		return CV_8UC1;
+	case PixelFormat::Gray16:
+		return CV_16UC1;
+	case PixelFormat::Gray32F:
+		return CV_32FC1;
+	case PixelFormat::BGRA8:
+		return CV_8UC4;
+	}
+	return CV_8UC1;
+}
+
+const char *Frame::FormatName(PixelFormat format) {
+	switch (format) {
+	case PixelFormat::Gray8:
+		return "8-bit gray";
+	case PixelFormat::Gray16:
+		return "16-bit gray";
+	case PixelFormat::Gray32F:
+		return "32-bit float gray";
+	case PixelFormat::BGRA8:
+		return "8-bit BGRA";
+	}
+	return "unknown";
+}
+
+void Frame::Convert(const cv::Mat &src, cv::Mat &dst, PixelFormat format) {
+	int type = CvType(format);
+	if (src.type() == type) {
+		if (src.data != dst.data) {
+			src.copyTo(dst);
+		}
+		return;
+	}
+
+	int depth = CV_MAT_DEPTH(type);
+	double scale = MaxValue(depth) / MaxValue(src.depth());
+
+	if (format == PixelFormat::BGRA8) {
+		cv::Mat gray8;
+		src.convertTo(gray8, CV_8U, scale);
+		cv::cvtColor(gray8, dst, cv::COLOR_GRAY2BGRA);
+		return;
+	}
+
+	cv::Mat gray = src;
+	if (src.channels() == 4) {
+		cv::cvtColor(src, gray, cv::COLOR_BGRA2GRAY);
+	}
+	gray.convertTo(dst, depth, scale);
+}
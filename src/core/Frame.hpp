@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+enum class PixelFormat { Gray8, Gray16, Gray32F, BGRA8 };
+
+// A single image in its native format. Intensities are 0-255 for 8 bit,
+// 0-65535 for 16 bit and 0-1 for float. Copies share the pixel data like
+// cv::Mat does, use Clone() for a deep copy.
+struct Frame {
+	Frame() = default;
+	explicit Frame(cv::Mat mat) : data(mat) {}
+	Frame(int width, int height, PixelFormat format) : data(height, width, CvType(format)) {}
+
+	// Non-owning view of a BGRA frame (the layout the textures use), so the
+	// uint32_t* based code can call into the Frame based one without copies
+	static Frame WrapBGRA(uint32_t *pixels, int width, int height) {
+		return Frame(cv::Mat(height, width, CV_8UC4, pixels));
+	}
+	static std::vector<Frame> WrapBGRA(const std::vector<uint32_t *> &pixels, int width, int height);
+
+	int Width() const { return data.cols; }
+	int Height() const { return data.rows; }
+	bool Empty() const { return data.empty(); }
+	PixelFormat Format() const;
+	Frame Clone() const { return Frame(data.clone()); }
+
+	// Converted copies, or the frame's own data if it already has that format
+	cv::Mat ToGray8() const { return Converted(PixelFormat::Gray8); }
+	cv::Mat ToGray32F() const { return Converted(PixelFormat::Gray32F); }
+	cv::Mat ToBGRA8() const { return Converted(PixelFormat::BGRA8); }
+	cv::Mat Converted(PixelFormat format) const;
+
+	// Writes `image` (any supported format, same size) into this frame,
+	// converting it to the frame's format. The pixel buffer is reused so views
+	// (e.g. WrapBGRA) see the result.
+	void Assign(const cv::Mat &image);
+
+	static int CvType(PixelFormat format);
+	static const char *FormatName(PixelFormat format);
+
+	// Converts between any of the supported formats, scaling the intensities.
+	// dst is only reallocated if it doesn't have the right size/type already.
+	static void Convert(const cv::Mat &src, cv::Mat &dst, PixelFormat format);
+
+	cv::Mat data;
+};
@@ -0,0 +1,321 @@
+#include <core/FrameCache.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <stdio.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr char kMagic[8] = {'E', 'D', 'A', 'F', 'R', 'A', 'M', 'E'};
+static constexpr uint32_t kVersion = 1;
+static constexpr size_t kPageSize = 4096;
+static constexpr size_t kRowAlignment = 64;
+
+// Everything is stored little endian and with fixed sizes, the index of frame
+// offsets follows right after the header
+struct FrameCache::Header {
+	char magic[8];
+	uint32_t version;
+	uint32_t format;
+	int32_t count;
+	int32_t width;
+	int32_t height;
+	uint32_t complete;
+	uint64_t row_stride;
+	uint64_t source_id;
+	uint64_t offsets[1];
+};
+
+static size_t AlignUp(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+static void Unmap(uint8_t *data, size_t size) {
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap(data, size);
+#endif
+}
+
+bool FrameCache::Create(const char *path, int count, int width, int height, PixelFormat format, uint64_t source_id) {
+	Close();
+	if (count <= 0 || width <= 0 || height <= 0) {
+		return false;
+	}
+
+	size_t row_stride = AlignUp(width * CV_ELEM_SIZE(Frame::CvType(format)), kRowAlignment);
+	size_t frame_stride = AlignUp(row_stride * height, kPageSize);
+	size_t data_offset = AlignUp(offsetof(Header, offsets) + count * sizeof(uint64_t), kPageSize);
+
+	// a name no other writer uses, whatever is at `path` stays untouched
+	static std::atomic<uint32_t> s_temp_counter = 0;
+#ifdef _WIN32
+	unsigned long process = GetCurrentProcessId();
+#else
+	unsigned long process = (unsigned long)getpid();
+#endif
+	char suffix[64];
+	snprintf(suffix, sizeof(suffix), ".%lu.%u.tmp", process, (unsigned)s_temp_counter++);
+	std::string temp_path = std::string(path) + suffix;
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+	if (!Map(temp_path.c_str(), data_offset + frame_stride * count, true)) {
+		return false;
+	}
+	m_path = path;
+	m_temp_path = temp_path;
+
+	Header *header = reinterpret_cast<Header *>(m_write_data);
+	memcpy(header->magic, kMagic, sizeof(kMagic));
+	header->version = kVersion;
+	header->format = (uint32_t)format;
+	header->count = count;
+	header->width = width;
+	header->height = height;
+	header->complete = 0;
+	header->row_stride = row_stride;
+	header->source_id = source_id;
+	for (int i = 0; i < count; i++) {
+		header->offsets[i] = data_offset + frame_stride * i;
+	}
+	return true;
+}
+
+bool FrameCache::Write(int index, const Frame &frame) {
+	if (!m_write_data || index < 0 || index >= Count() || frame.Width() != Width() ||
+	    frame.Height() != Height()) {
+		return false;
+	}
+	// converting straight into the view writes the frame into the file
+	const Header *header = GetHeader();
+	uint8_t *data = m_write_data + header->offsets[index];
+	cv::Mat view(header->height, header->width, Frame::CvType(Format()), data, header->row_stride);
+	Frame::Convert(frame.data, view, Format());
+	return view.data == data;
+}
+
+bool FrameCache::Finish() {
+	if (!m_write_data) {
+		return false;
+	}
+	reinterpret_cast<Header *>(m_write_data)->complete = 1;
+#ifdef _WIN32
+	bool flushed = FlushViewOfFile(m_write_data, 0) && FlushFileBuffers(m_file);
+#else
+	bool flushed = msync(m_write_data, m_size, MS_SYNC) == 0;
+#endif
+	if (!flushed) {
+		printf("Failed to flush frame cache %s\n", m_path.c_str());
+		return false;
+	}
+	Unmap(m_write_data, m_size);
+	m_write_data = nullptr;
+
+	// the views keep the file mapped whatever its name
+	std::error_code error;
+	std::filesystem::rename(m_temp_path, m_path, error);
+	if (error) {
+		// e.g. on Windows while another process has the old cache mapped.
+		// The frames are fine, the cache just isn't kept
+		printf("Could not move frame cache to %s: %s\n", m_path.c_str(), error.message().c_str());
+		return true;
+	}
+	m_temp_path.clear();
+	return true;
+}
+
+void FrameCache::Discard() {
+	if (!m_write_data) {
+		return;
+	}
+	Unmap(m_write_data, m_size);
+	m_write_data = nullptr;
+	// removing a mapped file is fine, it's gone once the views are unmapped
+	std::error_code error;
+	std::filesystem::remove(m_temp_path, error);
+	m_temp_path.clear();
+}
+
+bool FrameCache::Open(const char *path) {
+	Close();
+	if (!std::filesystem::exists(path) || !Map(path, 0, false)) {
+		return false;
+	}
+	m_path = path;
+
+	// the file can be anything left in the temp folder, nothing may be
+	// handed out as a view before it's clear every frame lies in the file
+	const Header *header = GetHeader();
+	bool valid = m_size >= sizeof(Header) && memcmp(header->magic, kMagic, sizeof(kMagic)) == 0 &&
+		     header->version == kVersion && header->complete && header->count > 0 &&
+		     header->width > 0 && header->height > 0 && header->format <= (uint32_t)PixelFormat::BGRA8 &&
+		     offsetof(Header, offsets) + header->count * sizeof(uint64_t) <= m_size;
+	if (valid) {
+		uint64_t row_size = (uint64_t)header->width * CV_ELEM_SIZE(Frame::CvType((PixelFormat)header->format));
+		valid = header->row_stride >= row_size && header->row_stride <= m_size / header->height;
+	}
+	if (valid) {
+		uint64_t frame_size = header->row_stride * header->height;
+		for (int i = 0; i < header->count && valid; i++) {
+			valid = header->offsets[i] % kPageSize == 0 && header->offsets[i] <= m_size &&
+				frame_size <= m_size - header->offsets[i];
+		}
+	}
+	if (!valid) {
+		printf("Frame cache %s is invalid or incomplete\n", path);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void FrameCache::Close() {
+	if (m_write_data) {
+		Unmap(m_write_data, m_size);
+		m_write_data = nullptr;
+	}
+	if (m_data) {
+		Unmap(m_data, m_size);
+		m_data = nullptr;
+	}
+#ifdef _WIN32
+	if (m_mapping) {
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+	if (m_file) {
+		CloseHandle(m_file);
+		m_file = nullptr;
+	}
+#else
+	if (m_fd >= 0) {
+		close(m_fd);
+		m_fd = -1;
+	}
+#endif
+	m_size = 0;
+
+	// the writer didn't get to Finish, or the finished file couldn't be moved
+	if (!m_temp_path.empty()) {
+		std::error_code error;
+		std::filesystem::remove(m_temp_path, error);
+		m_temp_path.clear();
+	}
+}
+
+bool FrameCache::Map(const char *path, size_t size, bool create) {
+#ifdef _WIN32
+	// shared for deleting so a finished cache can be renamed over an open one
+	HANDLE file = CreateFileA(path, create ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+				  FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, create ? CREATE_NEW : OPEN_EXISTING,
+				  FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("Failed to open frame cache %s\n", path);
+		return false;
+	}
+	m_file = file;
+	if (!create) {
+		LARGE_INTEGER file_size;
+		GetFileSizeEx(file, &file_size);
+		size = (size_t)file_size.QuadPart;
+	}
+	if (size == 0) {
+		Close();
+		return false;
+	}
+	// the mapping of a new file grows it to the requested size
+	m_mapping = CreateFileMappingA(file, nullptr, create ? PAGE_READWRITE : PAGE_WRITECOPY,
+				       (DWORD)((uint64_t)size >> 32), (DWORD)(size & 0xFFFFFFFF), nullptr);
+	if (m_mapping) {
+		m_data = (uint8_t *)MapViewOfFile(m_mapping, FILE_MAP_COPY, 0, 0, size);
+		if (create) {
+			m_write_data = (uint8_t *)MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, size);
+		}
+	}
+#else
+	m_fd = open(path, create ? O_RDWR | O_CREAT | O_EXCL : O_RDONLY, 0644);
+	if (m_fd < 0) {
+		printf("Failed to open frame cache %s\n", path);
+		return false;
+	}
+	if (create) {
+		if (ftruncate(m_fd, (off_t)size) != 0) {
+			printf("Failed to allocate %zu bytes for frame cache %s\n", size, path);
+			Close();
+			return false;
+		}
+	} else {
+		struct stat st;
+		if (fstat(m_fd, &st) != 0) {
+			Close();
+			return false;
+		}
+		size = (size_t)st.st_size;
+	}
+	if (size == 0) {
+		Close();
+		return false;
+	}
+	// private mappings are copy-on-write, in place processing never reaches
+	// the file. Pages nobody wrote to yet still show what Write puts there
+	void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, m_fd, 0);
+	m_data = data == MAP_FAILED ? nullptr : (uint8_t *)data;
+	if (create) {
+		data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+		m_write_data = data == MAP_FAILED ? nullptr : (uint8_t *)data;
+	}
+#endif
+
+	m_size = size;
+	if (!m_data || (create && !m_write_data)) {
+		printf("Failed to map frame cache %s\n", path);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+int FrameCache::Count() const { return m_data ? GetHeader()->count : 0; }
+int FrameCache::Width() const { return m_data ? GetHeader()->width : 0; }
+int FrameCache::Height() const { return m_data ? GetHeader()->height : 0; }
+PixelFormat FrameCache::Format() const { return m_data ? (PixelFormat)GetHeader()->format : PixelFormat::Gray8; }
+uint64_t FrameCache::SourceId() const { return m_data ? GetHeader()->source_id : 0; }
+
+Frame FrameCache::Get(int index) const {
+	const Header *header = GetHeader();
+	return Frame(cv::Mat(header->height, header->width, Frame::CvType(Format()), m_data + header->offsets[index],
+			     header->row_stride));
+}
+
+std::vector<Frame> FrameCache::Frames() const {
+	std::vector<Frame> frames;
+	frames.reserve(Count());
+	for (int i = 0; i < Count(); i++) {
+		frames.push_back(Get(i));
+	}
+	return frames;
+}
+
+std::string FrameCache::DefaultPath(const char *folder_path) {
+	std::error_code error;
+	std::filesystem::path folder = std::filesystem::weakly_canonical(folder_path, error);
+	if (error) {
+		folder = folder_path;
+	}
+	size_t hash = std::hash<std::string>{}(folder.string());
+
+	char name[64];
+	snprintf(name, sizeof(name), "%016zx.frames", hash);
+	return (std::filesystem::temp_directory_path() / "eda_frame_cache" / name).string();
+}
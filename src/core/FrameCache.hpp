@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <core/Frame.hpp>
+
+// The raw frames of a sequence in one memory mapped file, so sequences bigger
+// than RAM can be opened and the OS page cache decides what stays resident.
+//
+// The file starts with a header and an index of frame offsets, followed by the
+// frames. Every frame starts on a page boundary and rows are padded to 64
+// bytes. A cache is written once by a loader (Create, Write, Finish) and the
+// frames are handed out as views into the mapping, a frame as soon as it's
+// written.
+//
+// Several windows and processes can open the same folder, so a cache is
+// written under a name of its own and only renamed to its path once it's
+// complete. A file someone else still has mapped is never truncated or
+// rewritten, at most replaced by a new one.
+//
+// The views are mapped copy-on-write: modules can process them in place like
+// any other frame, the changes stay in memory and the file always keeps the
+// decoded originals. While a cache is written the file is mapped a second
+// time, shared, for Write. Frames are page aligned, so copying a page the
+// views modify never copies parts of frames that aren't written yet.
+class FrameCache {
+      public:
+	FrameCache() = default;
+	~FrameCache() { Close(); }
+
+	FrameCache(const FrameCache &) = delete;
+	FrameCache &operator=(const FrameCache &) = delete;
+
+	// Starts a new cache file for `count` frames, it replaces the one at
+	// `path` when it's finished. source_id identifies what the frames were
+	// decoded from, see SourceId()
+	bool Create(const char *path, int count, int width, int height, PixelFormat format, uint64_t source_id);
+	// Copies a frame into the cache, converting it to the cache's format
+	bool Write(int index, const Frame &frame);
+	// Marks the cache as complete, flushes it and moves it to its path. The
+	// views stay valid
+	bool Finish();
+	// Gives up on writing the cache, its file is deleted. The views handed
+	// out so far stay valid until Close
+	void Discard();
+
+	// Opens a finished cache, false if it doesn't exist or isn't valid
+	bool Open(const char *path);
+	// Invalidates all views, an unfinished cache file is deleted
+	void Close();
+
+	bool IsOpen() const { return m_data != nullptr; }
+	int Count() const;
+	int Width() const;
+	int Height() const;
+	PixelFormat Format() const;
+	uint64_t SourceId() const;
+
+	// Views into the mapping, valid until the cache is closed
+	Frame Get(int index) const;
+	std::vector<Frame> Frames() const;
+
+	// Where the cache of a folder is kept when the caller doesn't pick a path
+	static std::string DefaultPath(const char *folder_path);
+
+      private:
+	struct Header;
+
+	const Header *GetHeader() const { return reinterpret_cast<const Header *>(m_data); }
+	bool Map(const char *path, size_t size, bool create);
+
+	std::string m_path;
+	// the file being written, deleted on Close unless it was finished
+	std::string m_temp_path;
+	// the copy-on-write mapping the views point into
+	uint8_t *m_data = nullptr;
+	// the shared mapping Write goes through, only while writing
+	uint8_t *m_write_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void *m_file = nullptr;
+	void *m_mapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+};
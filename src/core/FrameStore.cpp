@@ -0,0 +1,50 @@
+#include <core/FrameStore.hpp>
+
+std::atomic<uint64_t> FrameStore::s_version_counter = 0;
+
+bool FrameStore::Add(Frame frame) {
+	if (!m_frames.empty() && (frame.Width() != Width() || frame.Height() != Height())) {
+		return false;
+	}
+	m_frames.push_back(ToStoreFormat(std::move(frame)));
+	m_versions.push_back(NextVersion());
+	return true;
+}
+
+void FrameStore::Set(size_t index, Frame frame) {
+	m_frames[index] = ToStoreFormat(std::move(frame));
+	m_versions[index] = NextVersion();
+}
+
+void FrameStore::Remove(size_t index) {
+	m_frames.erase(m_frames.begin() + index);
+	m_versions.erase(m_versions.begin() + index);
+}
+
+void FrameStore::Clear() {
+	m_frames.clear();
+	m_versions.clear();
+}
+
+size_t FrameStore::MemoryUsage() const {
+	size_t bytes = 0;
+	for (auto &frame : m_frames) {
+		bytes += frame.data.total() * frame.data.elemSize();
+	}
+	return bytes;
+}
+
+Frame FrameStore::ToStoreFormat(Frame frame) const {
+	if (!m_uniform_format) {
+		return frame;
+	}
+	// the first frame decides the format of the whole sequence
+	PixelFormat format = Format();
+	if (m_frames.empty()) {
+		format = frame.Format() == PixelFormat::BGRA8 ? PixelFormat::Gray8 : frame.Format();
+	}
+	if (frame.Format() == format) {
+		return frame;
+	}
+	return Frame(frame.Converted(format));
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <core/Frame.hpp>
+
+// The frames of a sequence, kept single channel. Color frames are reduced to 8
+// bit gray when added and every frame is converted to the format of the first
+// one, so a sequence costs 1, 2 or 4 bytes per pixel (8 bit, 16 bit, float)
+// instead of 4 for BGRA. Expanding to BGRA is left to the display code.
+//
+// A store can also keep every frame in the format it's given instead, for the
+// processed frames: they start out as (shared) views of the gray originals and
+// only the ones that get color drawn into them become BGRA.
+//
+// The store is the source of truth for the pixels, textures are only a display
+// cache. Every frame has a version that changes whenever it's replaced, so the
+// textures (and anything else derived from the pixels) know what to update.
+class FrameStore {
+      public:
+	FrameStore() = default;
+	explicit FrameStore(bool uniform_format) : m_uniform_format(uniform_format) {}
+
+	// false if the frame doesn't have the same size as the ones already stored
+	bool Add(Frame frame);
+	void Set(size_t index, Frame frame);
+	void Remove(size_t index);
+	void Clear();
+
+	// Frames modified in place through Get or Frames have to be marked dirty
+	Frame &Get(size_t index) { return m_frames[index]; }
+	const Frame &Get(size_t index) const { return m_frames[index]; }
+	void MarkDirty(size_t index) { m_versions[index] = NextVersion(); }
+
+	// the core modules take the frames directly
+	std::vector<Frame> &Frames() { return m_frames; }
+	const std::vector<Frame> &Frames() const { return m_frames; }
+
+	// unique across all stores, so it can be used as a cache key
+	uint64_t Version(size_t index) const { return m_versions[index]; }
+
+	size_t Size() const { return m_frames.size(); }
+	bool Empty() const { return m_frames.empty(); }
+	int Width() const { return m_frames.empty() ? 0 : m_frames[0].Width(); }
+	int Height() const { return m_frames.empty() ? 0 : m_frames[0].Height(); }
+	PixelFormat Format() const { return m_frames.empty() ? PixelFormat::Gray8 : m_frames[0].Format(); }
+
+	// bytes of pixel data held by the store
+	size_t MemoryUsage() const;
+
+      private:
+	static uint64_t NextVersion() { return ++s_version_counter; }
+
+	// the store's format for an incoming frame
+	Frame ToStoreFormat(Frame frame) const;
+
+	static std::atomic<uint64_t> s_version_counter;
+
+	bool m_uniform_format = true;
+	std::vector<Frame> m_frames;
+	std::vector<uint64_t> m_versions;
+};
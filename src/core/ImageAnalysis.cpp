@@ -1,82 +1,113 @@
 #include <core/ImageAnalysis.hpp>
 
+#include <core/ThreadPool.hpp>
 #include <utils.h>
 
 #include <opencv2/opencv.hpp>
 #include <algorithm>
+#include <cmath>
 
-void ImageAnalysis::AnalyzeImages(std::vector<uint32_t *> &frames, int width,
-				  int height,
+void ImageAnalysis::AnalyzeImages(const std::vector<Frame> &frames,
 				  std::vector<std::vector<float>> &histograms,
 				  std::vector<float> &avg_histogram,
 				  std::vector<float> &snrs, float &avg_snr) {
 	PROFILE_FUNCTION();
 
-	for (int i = 0; i < frames.size(); i++) {
-		histograms.push_back(std::vector<float>());
-		cv::Mat img(width, height, CV_8UC4, frames[i]);
-		cv::cvtColor(img, img, cv::COLOR_BGRA2GRAY);
-		cv::Scalar mean, stddev;
-		cv::meanStdDev(img, mean, stddev);
-		cv::Scalar snr = mean[0] / stddev[0];
-		snrs.push_back(snr[0]);
-		avg_snr += snr[0];
-
-		int bins = 256;
-		histograms[i].resize(bins);
-		avg_histogram.resize(bins);
-		cv::Mat hist;
-		float range[] = {0, 256};
-		const float *histRange = {range};
-		bool uniform = true, accumulate = false;
-		cv::calcHist(&img, 1, 0, cv::Mat(), hist, 1, &bins, &histRange,
-			     uniform, accumulate);
-		// Normalize for display
-		cv::normalize(hist, hist, 0, 1, cv::NORM_MINMAX);
+	if (frames.empty())
+		return;
 
+	// frames are independent, analyze them on the pool and reduce afterwards
+	size_t first = histograms.size();
+	histograms.resize(first + frames.size());
+	snrs.resize(first + frames.size());
+	ThreadPool::GetThreadPool().parallel_for(0, frames.size(), 1, [&](size_t i) {
+		AnalyzeFrame(frames[i], histograms[first + i], snrs[first + i]);
+	});
+
+	const int bins = 256;
+	avg_histogram.resize(bins);
+	for (size_t i = 0; i < frames.size(); i++) {
+		avg_snr += snrs[first + i];
 		for (int j = 0; j < bins; j++) {
-			histograms[i][j] = hist.at<float>(j);
-			avg_histogram[j] += hist.at<float>(j);
+			avg_histogram[j] += histograms[first + i][j];
 		}
 	}
 	for (int j = 0; j < avg_histogram.size(); j++) {
 		avg_histogram[j] /= frames.size();
 	}
-	avg_snr = frames.size() != 0 ? avg_snr / frames.size() : 0;
+	avg_snr /= frames.size();
 }
 
-void ImageAnalysis::AnalyzeRegion(uint32_t *frame, int width, int height,
-				  int roi_x, int roi_y, int roi_width, int roi_height,
+void ImageAnalysis::AnalyzeImages(std::vector<uint32_t *> &frames, int width,
+				  int height,
+				  std::vector<std::vector<float>> &histograms,
+				  std::vector<float> &avg_histogram,
+				  std::vector<float> &snrs, float &avg_snr) {
+	AnalyzeImages(Frame::WrapBGRA(frames, width, height), histograms,
+		      avg_histogram, snrs, avg_snr);
+}
+
+void ImageAnalysis::AnalyzeFrame(const Frame &frame,
+				 std::vector<float> &histogram, float &snr) {
+	// color frames are analyzed on their luminance, gray ones as they are
+	cv::Mat gray = frame.Format() == PixelFormat::BGRA8 ? frame.ToGray8()
+							     : frame.data;
+	AnalyzeGray(gray, histogram, snr);
+}
+
+void ImageAnalysis::AnalyzeFrame(uint32_t *frame, int width, int height,
+				 std::vector<float> &histogram, float &snr) {
+	AnalyzeFrame(Frame::WrapBGRA(frame, width, height), histogram, snr);
+}
+
+void ImageAnalysis::AnalyzeRegion(const Frame &frame, int roi_x, int roi_y,
+				  int roi_width, int roi_height,
 				  std::vector<float> &histogram, float &snr) {
 	PROFILE_FUNCTION();
 
-	// Create OpenCV Mat from the full image
-	cv::Mat img(height, width, CV_8UC4, frame);
-	cv::cvtColor(img, img, cv::COLOR_BGRA2GRAY);
-	
+	int width = frame.Width();
+	int height = frame.Height();
+
 	// Clamp ROI to image bounds
 	roi_x = std::max(0, std::min(roi_x, width - 1));
 	roi_y = std::max(0, std::min(roi_y, height - 1));
 	roi_width = std::max(1, std::min(roi_width, width - roi_x));
 	roi_height = std::max(1, std::min(roi_height, height - roi_y));
 	
-	// Extract region of interest
+	// Extract region of interest, only the region is converted
 	cv::Rect roi(roi_x, roi_y, roi_width, roi_height);
-	cv::Mat roi_img = img(roi);
-	
-	// Calculate SNR for the region
+	Frame region(frame.data(roi));
+	AnalyzeFrame(region, histogram, snr);
+}
+
+void ImageAnalysis::AnalyzeRegion(uint32_t *frame, int width, int height,
+				  int roi_x, int roi_y, int roi_width, int roi_height,
+				  std::vector<float> &histogram, float &snr) {
+	AnalyzeRegion(Frame::WrapBGRA(frame, width, height), roi_x, roi_y,
+		      roi_width, roi_height, histogram, snr);
+}
+
+void ImageAnalysis::AnalyzeGray(const cv::Mat &gray,
+				std::vector<float> &histogram, float &snr) {
 	cv::Scalar mean, stddev;
-	cv::meanStdDev(roi_img, mean, stddev);
+	cv::meanStdDev(gray, mean, stddev);
 	snr = stddev[0] > 0 ? mean[0] / stddev[0] : 0.0f;
-	
-	// Calculate histogram for the region
+
+	// bins cover the whole value range of the depth, the upper bound is
+	// exclusive so float frames need it nudged past 1
+	float upper = 256.0f;
+	if (gray.depth() == CV_16U)
+		upper = 65536.0f;
+	else if (gray.depth() == CV_32F)
+		upper = std::nextafter(1.0f, 2.0f);
+
 	int bins = 256;
 	histogram.resize(bins);
 	cv::Mat hist;
-	float range[] = {0, 256};
+	float range[] = {0, upper};
 	const float *histRange = {range};
 	bool uniform = true, accumulate = false;
-	cv::calcHist(&roi_img, 1, 0, cv::Mat(), hist, 1, &bins, &histRange,
+	cv::calcHist(&gray, 1, 0, cv::Mat(), hist, 1, &bins, &histRange,
 		     uniform, accumulate);
 	// Normalize for display
 	cv::normalize(hist, hist, 0, 1, cv::NORM_MINMAX);
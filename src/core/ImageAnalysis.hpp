@@ -3,16 +3,38 @@
 #include <cstdint>
 #include <vector>
 
+#include <core/Frame.hpp>
+
+// Histograms have 256 bins over the full range of the frame's format (0-255,
+// 0-65535 or 0-1), so 16 bit and float frames aren't quantized first
 class ImageAnalysis {
       public:
+	static void AnalyzeImages(const std::vector<Frame> &frames,
+				  std::vector<std::vector<float>> &histograms,
+				  std::vector<float> &avg_histogram,
+				  std::vector<float> &snrs, float &avg_snr);
 	static void AnalyzeImages(std::vector<uint32_t *> &frames, int width,
 				  int height,
 				  std::vector<std::vector<float>> &histograms,
 				  std::vector<float> &avg_histogram,
 				  std::vector<float> &snrs, float &avg_snr);
+
+	// Analysis of a single frame, used to only recompute frames that changed
+	static void AnalyzeFrame(const Frame &frame, std::vector<float> &histogram,
+				 float &snr);
+	static void AnalyzeFrame(uint32_t *frame, int width, int height,
+				 std::vector<float> &histogram, float &snr);
 	
 	// Regional analysis for a specific area of an image
+	static void AnalyzeRegion(const Frame &frame, int roi_x, int roi_y,
+				  int roi_width, int roi_height,
+				  std::vector<float> &histogram, float &snr);
 	static void AnalyzeRegion(uint32_t *frame, int width, int height,
 				  int roi_x, int roi_y, int roi_width, int roi_height,
 				  std::vector<float> &histogram, float &snr);
+
+      private:
+	// histogram and SNR of a single channel image
+	static void AnalyzeGray(const cv::Mat &gray, std::vector<float> &histogram,
+				float &snr);
 };
@@ -0,0 +1,75 @@
+#include <core/Job.hpp>
+
+#include <exception>
+#include <stdio.h>
+
+Job::Job() : m_state(std::make_shared<State>()) {}
+
+Job Job::Run(TaskPriority priority, std::function<bool(Job &)> work, std::function<void(bool)> callback) {
+	Job job;
+	ThreadPool::GetThreadPool().submit(
+	    [work = std::move(work), callback = std::move(callback), job]() mutable {
+		    job.Start();
+		    bool result = false;
+		    // cancelled while it was still queued, it never has to start
+		    if (!job.IsCancelled()) {
+			    try {
+				    result = work(job);
+			    } catch (const std::exception &e) {
+				    printf("Job failed: %s\n", e.what());
+			    } catch (...) {
+				    printf("Job failed: unknown exception\n");
+			    }
+		    }
+		    job.Finish(result);
+		    if (callback) {
+			    callback(result);
+		    }
+	    },
+	    priority);
+	return job;
+}
+
+void Job::Start() {
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	m_state->start = Clock::now();
+	m_state->status = Status::Running;
+}
+
+void Job::Finish(bool result) {
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	m_state->result = result;
+	m_state->end = Clock::now();
+	if (result) {
+		m_state->progress = 1.0f;
+	}
+	m_state->status = Status::Finished;
+	m_state->finished.notify_all();
+}
+
+void Job::SetProgress(float progress) const { m_state->progress = progress; }
+
+void Job::SetStage(const std::string &stage) const {
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	m_state->stage = stage;
+}
+
+std::string Job::GetStage() const {
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	return m_state->stage;
+}
+
+double Job::GetElapsed() const {
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	if (m_state->status == Status::Queued) {
+		return 0.0;
+	}
+	auto end = m_state->status == Status::Finished ? m_state->end : Clock::now();
+	return std::chrono::duration<double>(end - m_state->start).count();
+}
+
+bool Job::Wait() const {
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	m_state->finished.wait(lock, [this]() { return m_state->status == Status::Finished; });
+	return m_state->result;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <core/ThreadPool.hpp>
+
+// Handle to one run of a long operation, returned by the async APIs. The job
+// reports its progress and the name of the stage it's in while it runs, can be
+// cancelled and holds its result once it finished. Every job has its own
+// state, so any number of them can run at the same time and be monitored
+// separately. Copies refer to the same job.
+//
+// The synchronous versions of the operations take a job too, to report to and
+// to check for cancellation. A default constructed one is simply not watched.
+class Job {
+      public:
+	enum class Status { Queued, Running, Finished };
+
+	Job();
+
+	// Runs work(job) as a task on the pool and returns its job. The callback
+	// gets the result once the job finished, on the thread that ran it.
+	// An exception thrown by the work fails the job.
+	static Job Run(TaskPriority priority, std::function<bool(Job &)> work,
+		       std::function<void(bool)> callback = nullptr);
+
+	// called by the work itself
+	void Start();
+	void Finish(bool result);
+	// progress of the whole job, from 0 to 1
+	void SetProgress(float progress) const;
+	void SetStage(const std::string &stage) const;
+
+	Status GetStatus() const { return m_state->status; }
+	// queued jobs count as running, they just haven't got a worker yet
+	bool IsRunning() const { return GetStatus() != Status::Finished; }
+	bool IsFinished() const { return GetStatus() == Status::Finished; }
+	float GetProgress() const { return m_state->progress; }
+	std::string GetStage() const;
+	// seconds since the job started, or how long it ran once it finished
+	double GetElapsed() const;
+
+	void Cancel() const { m_state->token.cancel(); }
+	bool IsCancelled() const { return m_state->token.is_cancelled(); }
+	const CancellationToken &GetToken() const { return m_state->token; }
+
+	// only meaningful once the job finished
+	bool GetResult() const { return m_state->result; }
+	// Blocks until the job finished and returns its result
+	bool Wait() const;
+
+      private:
+	using Clock = std::chrono::steady_clock;
+
+	struct State {
+		std::atomic<Status> status = Status::Queued;
+		std::atomic<float> progress = 0.0f;
+		std::atomic<bool> result = false;
+		CancellationToken token;
+
+		// the stage, the timing and waiting on the job
+		mutable std::mutex mutex;
+		std::condition_variable finished;
+		std::string stage;
+		Clock::time_point start;
+		Clock::time_point end;
+	};
+
+	std::shared_ptr<State> m_state;
+};
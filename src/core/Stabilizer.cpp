@@ -5,17 +5,15 @@
 
 #include <opencv2/opencv.hpp>
 
-// Static member initialization
-float Stabilizer::m_progress = 0.0f;
-bool Stabilizer::m_is_processing = false;
-
 bool Stabilizer::Stabilize(std::vector<uint32_t *> &frames, int width,
-			   int height) {
+			   int height, const Job &job) {
 	PROFILE_FUNCTION();
 
 	if (frames.empty())
 		return false;
 
+	job.SetStage("Aligning frames");
+
 	std::vector<cv::Mat> mats;
 	for (auto &ptr : frames) {
 		cv::Mat img(height, width, CV_8UC4,
@@ -31,6 +29,10 @@ bool Stabilizer::Stabilize(std::vector<uint32_t *> &frames, int width,
 	stabilizedFrames.push_back(mats[0].clone());
 
 	for (size_t i = 1; i < mats.size(); i++) {
+		if (job.IsCancelled()) {
+			return false;
+		}
+
 		cv::cvtColor(mats[i], currGray, cv::COLOR_RGBA2GRAY);
 
 		std::vector<cv::Point2f> refPts, currPts;
@@ -71,10 +73,10 @@ bool Stabilizer::Stabilize(std::vector<uint32_t *> &frames, int width,
 			       mats[i].size(), cv::INTER_LINEAR,
 			       cv::BORDER_CONSTANT);
 		stabilizedFrames.push_back(stabilized);
-		m_progress =
-		    static_cast<float>(i) / mats.size(); // Update progress
+		job.SetProgress(static_cast<float>(i) / mats.size());
 	}
 
+	job.SetStage("Writing frames");
 	for (size_t i = 0; i < frames.size(); i++) {
 		std::memcpy(frames[i], stabilizedFrames[i].data,
 			    width * height * 4);
@@ -82,25 +84,12 @@ bool Stabilizer::Stabilize(std::vector<uint32_t *> &frames, int width,
 	return true;
 }
 
-std::future<bool>
-Stabilizer::StabilizeAsync(std::vector<uint32_t *> &frames, int width,
-			   int height, std::function<void(bool)> callback) {
-	// Set processing flag
-	m_is_processing = true;
-	m_progress = 0.0f;
-	// Get the thread pool
-	auto &pool = ThreadPool::GetThreadPool();
-	// Submit task to thread pool
-	auto future = pool.enqueue([&frames, width, height, callback]() {
-		bool result = Stabilize(frames, width, height);
-		// When complete, update processing flag and call callback if
-		// provided
-		m_is_processing = false;
-		if (callback) {
-			callback(result);
-		}
-		return result;
-	});
-	m_progress = 1.0f; // Set progress to 100% immediately for async
-	return future;
+Job Stabilizer::StabilizeAsync(std::vector<uint32_t *> &frames, int width,
+			       int height, std::function<void(bool)> callback) {
+	return Job::Run(
+	    TaskPriority::Batch,
+	    [&frames, width, height](Job &job) {
+		    return Stabilize(frames, width, height, job);
+	    },
+	    callback);
 }
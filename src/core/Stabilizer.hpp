@@ -5,18 +5,16 @@
 #include <future>
 #include <vector>
 
+#include <core/Job.hpp>
+
 class Stabilizer {
       public:
+	// frames are only written back once all of them are aligned, so a
+	// cancelled run leaves them untouched
 	static bool Stabilize(std::vector<uint32_t *> &frames, int width,
-			      int height);
-	static std::future<bool>
-	StabilizeAsync(std::vector<uint32_t *> &frames, int width, int height,
-		       std::function<void(bool)> callback = nullptr);
-
-	static bool IsProcessing() { return m_is_processing; }
-	static float GetProgress() { return m_progress; }
-
-      private:
-	static float m_progress;
-	static bool m_is_processing;
+			      int height, const Job &job = Job());
+	// the frames have to stay alive until the job finished
+	static Job StabilizeAsync(std::vector<uint32_t *> &frames, int width,
+				  int height,
+				  std::function<void(bool)> callback = nullptr);
 };
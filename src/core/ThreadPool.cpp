@@ -1,6 +1,23 @@
 #include "ThreadPool.hpp"
 
-ThreadPool::ThreadPool(size_t num_threads) : m_stop(false), m_active_tasks(0) {
+#include <chrono>
+#include <stdexcept>
+
+thread_local ThreadPool *ThreadPool::t_pool = nullptr;
+thread_local int ThreadPool::t_worker_index = -1;
+thread_local int ThreadPool::t_current_lane = -1;
+thread_local int ThreadPool::t_current_session = 0;
+thread_local bool ThreadPool::t_share_yielded = false;
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : m_sleeping(0), m_pending(0), m_stop(false), m_active_tasks(0), m_active_sessions(0), m_next_session(1) {
+	for (auto &lane_pending : m_lane_pending) {
+		lane_pending = 0;
+	}
+	for (int i = 0; i < kSessionSlots; ++i) {
+		m_session_tasks[i] = 0;
+		m_session_running[i] = 0;
+	}
 
 	// Use hardware concurrency if num_threads is 0
 	if (num_threads == 0) {
@@ -11,43 +28,19 @@ ThreadPool::ThreadPool(size_t num_threads) : m_stop(false), m_active_tasks(0) {
 		}
 	}
 
+	// create all the queues before starting any worker, they steal from each other
 	for (size_t i = 0; i < num_threads; ++i) {
-		m_workers.emplace_back([this] {
-			while (true) {
-				std::function<void()> task;
-
-				{
-					std::unique_lock<std::mutex> lock(
-					    m_queue_mutex);
-
-					// Wait until there's a task or the pool
-					// is stopped
-					m_condition.wait(lock, [this] {
-						return m_stop ||
-						       !m_tasks.empty();
-					});
-
-					// Exit if the pool is stopped and there
-					// are no more tasks
-					if (m_stop && m_tasks.empty()) {
-						return;
-					}
-
-					// Get the next task
-					task = std::move(m_tasks.front());
-					m_tasks.pop();
-				}
-
-				// Execute the task
-				task();
-			}
-		});
+		m_queues.push_back(std::make_unique<WorkQueue>());
+	}
+
+	for (size_t i = 0; i < num_threads; ++i) {
+		m_workers.emplace_back([this, i] { worker_loop((int)i); });
 	}
 }
 
 ThreadPool::~ThreadPool() {
 	{
-		std::unique_lock<std::mutex> lock(m_queue_mutex);
+		std::unique_lock<std::mutex> lock(m_sleep_mutex);
 		m_stop = true;
 	}
 
@@ -62,14 +55,263 @@ ThreadPool::~ThreadPool() {
 	}
 }
 
-size_t ThreadPool::get_queue_size() {
-	std::unique_lock<std::mutex> lock(m_queue_mutex);
-	return m_tasks.size();
+int ThreadPool::current_worker_index() const { return t_pool == this ? t_worker_index : -1; }
+
+int ThreadPool::lane_for(TaskPriority priority) const {
+	if (priority != TaskPriority::Inherit) {
+		return (int)priority;
+	}
+	if (is_worker_thread() && t_current_lane >= 0) {
+		return t_current_lane;
+	}
+	return (int)TaskPriority::Normal;
+}
+
+void ThreadPool::push(Task task, TaskPriority priority) {
+	// Don't allow enqueueing after stopping the pool
+	if (m_stop) {
+		throw std::runtime_error("Enqueue on stopped ThreadPool");
+	}
+
+	int lane = lane_for(priority);
+
+	// count the task before it becomes visible so m_pending never drops below
+	// the number of queued tasks
+	m_pending++;
+	m_lane_pending[lane]++;
+
+	int session = t_current_session;
+	if (m_session_tasks[session]++ == 0) {
+		m_active_sessions++;
+	}
+
+	int index = current_worker_index();
+	WorkQueue &queue = index >= 0 ? *m_queues[index] : m_injection_queue;
+	{
+		std::unique_lock<std::mutex> lock(queue.mutex);
+		queue.tasks[lane].push_back({std::move(task), session});
+	}
+
+	// only take the sleep lock if someone might actually be waiting on it,
+	// a worker registers as sleeping before it checks m_pending so it can't
+	// miss this task
+	if (m_sleeping > 0) {
+		{ std::unique_lock<std::mutex> lock(m_sleep_mutex); }
+		m_condition.notify_one();
+	}
+}
+
+bool ThreadPool::try_pop(QueuedTask &task, int &lane, int worker_index) {
+	if (m_pending == 0) {
+		return false;
+	}
+
+	auto take = [&](std::deque<QueuedTask> &tasks, size_t index, int l) {
+		task = std::move(tasks[index]);
+		if (index + 1 == tasks.size()) {
+			tasks.pop_back();
+		} else if (index == 0) {
+			tasks.pop_front();
+		} else {
+			tasks.erase(tasks.begin() + index);
+		}
+		m_lane_pending[l]--;
+		m_pending--;
+		lane = l;
+	};
+
+	// lanes are searched in priority order, a lower lane is only looked at if
+	// nothing with a higher priority is queued anywhere
+	for (int l = 0; l < kLanes; ++l) {
+		if (m_lane_pending[l] == 0) {
+			continue;
+		}
+
+		// own deque first, newest task first since its data is most likely still in cache
+		if (worker_index >= 0) {
+			WorkQueue &own = *m_queues[worker_index];
+			std::unique_lock<std::mutex> lock(own.mutex);
+			if (!own.tasks[l].empty()) {
+				take(own.tasks[l], own.tasks[l].size() - 1, l);
+				return true;
+			}
+		}
+
+		// then work submitted from outside the pool, where the sessions
+		// take turns
+		{
+			std::unique_lock<std::mutex> lock(m_injection_queue.mutex);
+			if (!m_injection_queue.tasks[l].empty()) {
+				take(m_injection_queue.tasks[l], pick_fair(m_injection_queue.tasks[l]), l);
+				return true;
+			}
+		}
+
+		// then steal the oldest task of a sibling, starting with the next one so
+		// thieves spread out over the victims
+		size_t count = m_queues.size();
+		size_t start = worker_index >= 0 ? worker_index + 1 : 0;
+		for (size_t i = 0; i < count; ++i) {
+			size_t victim = (start + i) % count;
+			if ((int)victim == worker_index) {
+				continue;
+			}
+			WorkQueue &queue = *m_queues[victim];
+			std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+			if (!lock.owns_lock() || queue.tasks[l].empty()) {
+				continue;
+			}
+			take(queue.tasks[l], 0, l);
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::worker_loop(int worker_index) {
+	t_pool = this;
+	t_worker_index = worker_index;
+
+	while (true) {
+		QueuedTask task;
+		int lane;
+		if (!try_pop(task, lane, worker_index)) {
+			std::unique_lock<std::mutex> lock(m_sleep_mutex);
+			m_sleeping++;
+
+			// Wait until there's a task or the pool is stopped
+			m_condition.wait(lock, [this] { return m_stop || m_pending > 0; });
+			m_sleeping--;
+
+			// Exit if the pool is stopped and there are no more tasks
+			if (m_stop && m_pending == 0) {
+				return;
+			}
+			continue;
+		}
+
+		run_task(task, lane);
+	}
+}
+
+void ThreadPool::run_task(QueuedTask &task, int lane) {
+	// tasks submitted while this one runs inherit its lane and session
+	int previous_lane = t_current_lane;
+	int previous_session = t_current_session;
+	bool previous_yielded = t_share_yielded;
+	t_current_lane = lane;
+	t_current_session = task.session;
+	t_share_yielded = false;
+
+	// Execute the task
+	m_active_tasks++;
+	m_session_running[task.session]++;
+	task.task();
+	if (!t_share_yielded) {
+		m_session_running[task.session]--;
+	}
+	m_active_tasks--;
+
+	if (--m_session_tasks[task.session] == 0) {
+		m_active_sessions--;
+	}
+	t_current_lane = previous_lane;
+	t_current_session = previous_session;
+	t_share_yielded = previous_yielded;
+
+	if (m_on_task_complete) {
+		m_on_task_complete();
+	}
 }
 
+size_t ThreadPool::get_queue_size() { return m_pending; }
+
 void ThreadPool::set_on_task_complete(std::function<void()> callback) {
-	std::unique_lock<std::mutex> lock(m_queue_mutex);
+	std::unique_lock<std::mutex> lock(m_sleep_mutex);
 	m_on_task_complete = callback;
 }
 
 size_t ThreadPool::get_active_tasks() const { return m_active_tasks; }
+
+int ThreadPool::create_session() {
+	// 0 is left for untagged work
+	return m_next_session++ % (kSessionSlots - 1) + 1;
+}
+
+size_t ThreadPool::get_fair_share() const {
+	size_t sessions = (size_t)std::max(1, (int)m_active_sessions);
+	return std::max<size_t>(1, (get_thread_count() + sessions - 1) / sessions);
+}
+
+size_t ThreadPool::pick_fair(const std::deque<QueuedTask> &tasks) const {
+	// the oldest task of the session with the fewest running tasks
+	size_t best = 0;
+	int best_running = m_session_running[tasks[0].session];
+	size_t count = std::min(tasks.size(), kFairScan);
+	for (size_t i = 1; i < count && best_running > 0; ++i) {
+		int running = m_session_running[tasks[i].session];
+		if (running < best_running) {
+			best = i;
+			best_running = running;
+		}
+	}
+	return best;
+}
+
+bool ThreadPool::yield_share() {
+	if (!is_worker_thread()) {
+		return false;
+	}
+	// a helper run by a waiting task that already gave its worker up
+	if (t_share_yielded) {
+		return true;
+	}
+	// the count drops right away so only as many tasks as there are
+	// workers over the share give theirs up
+	std::atomic<int> &running = m_session_running[t_current_session];
+	int share = (int)get_fair_share();
+	int current = running;
+	while (current > share) {
+		if (running.compare_exchange_weak(current, current - 1)) {
+			t_share_yielded = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TaskGroup::run_next(State &state) {
+	Task task;
+	{
+		std::unique_lock<std::mutex> lock(state.mutex);
+		if (state.tasks.empty()) {
+			return false;
+		}
+		task = std::move(state.tasks.front());
+		state.tasks.pop_front();
+	}
+	task();
+	return true;
+}
+
+void TaskGroup::finish_one(State &state) {
+	// lock so a waiter can't check its condition and go to sleep in between,
+	// every finished task wakes the waiters since wait_until() waits on more
+	// than just the count
+	std::unique_lock<std::mutex> lock(state.mutex);
+	state.pending--;
+	state.condition.notify_all();
+}
+
+void TaskGroup::wait() {
+	wait_until([this] { return m_state->pending == 0; });
+
+	std::exception_ptr exception;
+	{
+		std::unique_lock<std::mutex> lock(m_state->mutex);
+		std::swap(exception, m_state->exception);
+	}
+	if (exception) {
+		std::rethrow_exception(exception);
+	}
+}
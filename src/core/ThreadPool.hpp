@@ -1,20 +1,154 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <future>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
+// Move-only type erased callable. Closures up to kInlineSize bytes are stored
+// inline so submitting small tasks doesn't allocate, bigger ones go on the heap.
+class Task {
+      public:
+	static constexpr size_t kInlineSize = 64;
+
+	Task() = default;
+
+	template <class F, class = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>> Task(F &&f) {
+		using Fn = std::decay_t<F>;
+		if constexpr (FitsInline<Fn>()) {
+			new (m_storage) Fn(std::forward<F>(f));
+			m_ops = &InlineOps<Fn>;
+		} else {
+			*reinterpret_cast<Fn **>(m_storage) = new Fn(std::forward<F>(f));
+			m_ops = &HeapOps<Fn>;
+		}
+	}
+
+	Task(Task &&other) noexcept { MoveFrom(other); }
+
+	Task &operator=(Task &&other) noexcept {
+		if (this != &other) {
+			Reset();
+			MoveFrom(other);
+		}
+		return *this;
+	}
+
+	Task(const Task &) = delete;
+	Task &operator=(const Task &) = delete;
+
+	~Task() { Reset(); }
+
+	explicit operator bool() const { return m_ops != nullptr; }
+
+	void operator()() { m_ops->invoke(m_storage); }
+
+      private:
+	struct Ops {
+		void (*invoke)(void *);
+		void (*move)(void *dst, void *src);
+		void (*destroy)(void *);
+	};
+
+	template <class Fn> static constexpr bool FitsInline() {
+		return sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(std::max_align_t) &&
+		       std::is_nothrow_move_constructible_v<Fn>;
+	}
+
+	template <class Fn>
+	static constexpr Ops InlineOps = {
+	    [](void *p) { (*static_cast<Fn *>(p))(); },
+	    [](void *dst, void *src) {
+		    new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+		    static_cast<Fn *>(src)->~Fn();
+	    },
+	    [](void *p) { static_cast<Fn *>(p)->~Fn(); }};
+
+	template <class Fn>
+	static constexpr Ops HeapOps = {
+	    [](void *p) { (**static_cast<Fn **>(p))(); },
+	    [](void *dst, void *src) { *static_cast<Fn **>(dst) = *static_cast<Fn **>(src); },
+	    [](void *p) { delete *static_cast<Fn **>(p); }};
+
+	void MoveFrom(Task &other) {
+		m_ops = other.m_ops;
+		if (m_ops) {
+			m_ops->move(m_storage, other.m_storage);
+			other.m_ops = nullptr;
+		}
+	}
+
+	void Reset() {
+		if (m_ops) {
+			m_ops->destroy(m_storage);
+			m_ops = nullptr;
+		}
+	}
+
+	alignas(std::max_align_t) unsigned char m_storage[kInlineSize];
+	const Ops *m_ops = nullptr;
+};
+
+// Lanes a task can be queued in. Workers always take the highest priority task
+// available, so interactive work gets picked up at the next task boundary even
+// when a long batch job has queued thousands of tiles.
+// Inherit uses the priority of the task currently running on this thread, or
+// Normal when submitted from outside the pool.
+enum class TaskPriority { Interactive = 0, Normal = 1, Batch = 2, Inherit = 3 };
+
+// Shared flag that long running loops check between frames/tiles so a job can
+// be aborted. Copies refer to the same flag.
+class CancellationToken {
+      public:
+	CancellationToken() : m_cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+	void cancel() { *m_cancelled = true; }
+	bool is_cancelled() const { return *m_cancelled; }
+
+      private:
+	std::shared_ptr<std::atomic<bool>> m_cancelled;
+};
+
+// Work stealing thread pool. Every worker owns a deque, tasks submitted from a
+// worker go to the back of its own deque and are popped LIFO (cache friendly),
+// tasks submitted from other threads go to a shared injection queue. Idle
+// workers steal from the front of their siblings' deques.
 class ThreadPool {
       public:
 	// Add a task to the thread pool
 	template <class F, class... Args>
 	auto enqueue(F &&f, Args &&...args)
 	    -> std::future<typename std::invoke_result<F, Args...>::type>;
+	template <class F, class... Args>
+	auto enqueue(TaskPriority priority, F &&f, Args &&...args)
+	    -> std::future<typename std::invoke_result<F, Args...>::type>;
+
+	// Add a fire-and-forget task, cheaper than enqueue since there is no
+	// future/shared state to allocate
+	template <class F> void submit(F &&f, TaskPriority priority = TaskPriority::Inherit);
+
+	// Calls fn(i) for every i in [begin, end), split into chunks of `grain`
+	// indices that run on the pool. The calling thread works on chunks too and
+	// this is safe to call from inside a pool task. Chunks are queued as
+	// Interactive when called from outside the pool since the caller is
+	// blocked on them.
+	template <class F>
+	void parallel_for(size_t begin, size_t end, size_t grain, F &&fn,
+			  TaskPriority priority = TaskPriority::Inherit);
+
+	// true if the calling thread is one of this pool's workers
+	bool is_worker_thread() const { return current_worker_index() >= 0; }
 
 	static ThreadPool &GetThreadPool() {
 		static ThreadPool instance;
@@ -30,53 +164,265 @@ class ThreadPool {
 	// Get the number of active tasks
 	size_t get_active_tasks() const;
 
+	// Get the number of worker threads
+	size_t get_thread_count() const { return m_workers.size(); }
+
+	// Sessions group the work of independent users of the pool, like the
+	// open image sets, so one of them can't keep the others waiting. Tasks
+	// belong to the session of the thread that queued them (see
+	// SessionScope), tasks queued from a pool task inherit its session.
+	// Queued work is handed out to the session with the fewest running tasks
+	// first and parallel_for helpers give their worker back when their
+	// session has more than its share. Session 0 is everything untagged.
+	int create_session();
+
+	// workers a session gets while several of them have work, at least one
+	size_t get_fair_share() const;
+
       private:
+	friend class SessionScope;
+
 	// private because we want to use the singleton pattern
 	ThreadPool(size_t num_threads = 0);
 	~ThreadPool();
 
+	static constexpr int kLanes = 3;
+	// session ids are wrapped into this many slots, sessions sharing a slot
+	// are just scheduled as one
+	static constexpr int kSessionSlots = 64;
+	// how far into a shared queue to look for the task of a less busy session
+	static constexpr size_t kFairScan = 32;
+
+	struct QueuedTask {
+		Task task;
+		int session = 0;
+	};
+
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<QueuedTask> tasks[kLanes];
+	};
+
+	void push(Task task, TaskPriority priority);
+	bool try_pop(QueuedTask &task, int &lane, int worker_index);
+	void run_task(QueuedTask &task, int lane);
+	void worker_loop(int worker_index);
+
+	// index of the task a worker should take from a shared queue
+	size_t pick_fair(const std::deque<QueuedTask> &tasks) const;
+	// Gives up the worker of the running task if its session holds more
+	// workers than its share, the task has to return right after when true
+	bool yield_share();
+
+	// resolves Inherit to an actual lane for a task submitted from this thread
+	int lane_for(TaskPriority priority) const;
+
+	// index of the current thread in m_queues, -1 if it isn't one of our workers
+	int current_worker_index() const;
+
+	static thread_local ThreadPool *t_pool;
+	static thread_local int t_worker_index;
+	static thread_local int t_current_lane;
+	static thread_local int t_current_session;
+	static thread_local bool t_share_yielded;
+
 	std::vector<std::thread> m_workers;
-	std::queue<std::function<void()>> m_tasks;
+	std::vector<std::unique_ptr<WorkQueue>> m_queues;
+	WorkQueue m_injection_queue;
 
-	std::mutex m_queue_mutex;
+	std::mutex m_sleep_mutex;
 	std::condition_variable m_condition;
+	std::atomic<size_t> m_sleeping;
+	std::atomic<size_t> m_pending;
+	std::atomic<size_t> m_lane_pending[kLanes];
 	std::atomic<bool> m_stop;
 	std::atomic<size_t> m_active_tasks;
 	std::function<void()> m_on_task_complete;
+
+	// queued and running tasks of each session slot, and how many slots have any
+	std::atomic<int> m_session_tasks[kSessionSlots];
+	std::atomic<int> m_session_running[kSessionSlots];
+	std::atomic<int> m_active_sessions;
+	std::atomic<int> m_next_session;
+};
+
+// Tags everything the current thread queues on the pool with a session (from
+// ThreadPool::create_session) while it's alive, e.g. around the UI code of one
+// image set
+class SessionScope {
+      public:
+	explicit SessionScope(int session) : m_previous(ThreadPool::t_current_session) {
+		ThreadPool::t_current_session = session;
+	}
+	~SessionScope() { ThreadPool::t_current_session = m_previous; }
+
+	SessionScope(const SessionScope &) = delete;
+	SessionScope &operator=(const SessionScope &) = delete;
+
+      private:
+	int m_previous;
 };
 
 // Implementation of the enqueue function
 template <class F, class... Args>
 auto ThreadPool::enqueue(F &&f, Args &&...args)
+    -> std::future<typename std::invoke_result<F, Args...>::type> {
+	return enqueue(TaskPriority::Inherit, std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+template <class F, class... Args>
+auto ThreadPool::enqueue(TaskPriority priority, F &&f, Args &&...args)
     -> std::future<typename std::invoke_result<F, Args...>::type> {
 
 	using return_type = typename std::invoke_result<F, Args...>::type;
 
-	auto task = std::make_shared<std::packaged_task<return_type()>>(
-	    std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+	std::packaged_task<return_type()> task(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+	std::future<return_type> res = task.get_future();
 
-	std::future<return_type> res = task->get_future();
+	push(Task([task = std::move(task)]() mutable { task(); }), priority);
+	return res;
+}
 
-	{
-		std::unique_lock<std::mutex> lock(m_queue_mutex);
+template <class F> void ThreadPool::submit(F &&f, TaskPriority priority) {
+	push(Task(std::forward<F>(f)), priority);
+}
 
-		// Don't allow enqueueing after stopping the pool
-		if (m_stop) {
-			throw std::runtime_error(
-			    "Enqueue on stopped ThreadPool");
+// A set of tasks that can be waited on together. The tasks wait in a queue of
+// the group and every one of them also queues a stub on the pool that runs the
+// next task of the group, if there still is one. When called from a worker,
+// wait() runs the group's own queued tasks while the group isn't finished, so
+// waiting from inside a pool task (nested parallelism) keeps the worker busy
+// instead of starving the pool. It never picks up anything else, a waiter
+// can't get stuck in some unrelated long job long after its own work is done.
+// Other threads (e.g. the UI thread) just block.
+class TaskGroup {
+      public:
+	explicit TaskGroup(ThreadPool &pool = ThreadPool::GetThreadPool(),
+			   TaskPriority priority = TaskPriority::Inherit)
+	    : m_pool(pool), m_priority(priority), m_state(std::make_shared<State>()) {}
+	// a group must never be destroyed while its tasks still reference it
+	~TaskGroup() {
+		try {
+			wait();
+		} catch (...) {
 		}
+	}
+
+	TaskGroup(const TaskGroup &) = delete;
+	TaskGroup &operator=(const TaskGroup &) = delete;
+
+	template <class F> void run(F &&f);
 
-		m_tasks.emplace([this, task]() {
-			m_active_tasks++;
-			(*task)();
-			m_active_tasks--;
+	// Blocks until every task in the group finished, rethrows the first
+	// exception thrown by one of them
+	void wait();
+
+	// Blocks until done() returns true, helping with the group's tasks like
+	// wait(). done() is checked again whenever a task of the group finished.
+	template <class Pred> void wait_until(Pred &&done);
+
+      private:
+	// shared with the stubs on the pool, they can outlive the group when a
+	// waiter already ran their task
+	struct State {
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<Task> tasks;
+		std::atomic<size_t> pending{0};
+		std::exception_ptr exception;
+	};
 
-			if (m_on_task_complete) {
-				m_on_task_complete();
+	// runs the oldest queued task of the group, false if there is none
+	static bool run_next(State &state);
+	static void finish_one(State &state);
+
+	ThreadPool &m_pool;
+	TaskPriority m_priority;
+	std::shared_ptr<State> m_state;
+};
+
+template <class F> void TaskGroup::run(F &&f) {
+	State *state = m_state.get();
+	state->pending++;
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->tasks.emplace_back([state, f = std::forward<F>(f)]() mutable {
+			try {
+				f();
+			} catch (...) {
+				std::unique_lock<std::mutex> lock(state->mutex);
+				if (!state->exception) {
+					state->exception = std::current_exception();
+				}
 			}
+			finish_one(*state);
 		});
 	}
+	m_pool.submit([state = m_state]() { run_next(*state); }, m_priority);
+}
 
-	m_condition.notify_one();
-	return res;
+template <class Pred> void TaskGroup::wait_until(Pred &&done) {
+	State &state = *m_state;
+	while (!done()) {
+		if (m_pool.is_worker_thread() && run_next(state)) {
+			continue;
+		}
+
+		// nothing left to help with, the remaining tasks are running on
+		// other threads. Wake up regularly in case one of them queues more
+		// work for the group.
+		std::unique_lock<std::mutex> lock(state.mutex);
+		state.condition.wait_for(lock, std::chrono::milliseconds(1), done);
+	}
+}
+
+template <class F>
+void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain, F &&fn, TaskPriority priority) {
+	if (begin >= end) {
+		return;
+	}
+	if (grain == 0) {
+		grain = 1;
+	}
+
+	// small ranges aren't worth the scheduling
+	if (end - begin <= grain) {
+		for (size_t i = begin; i < end; ++i) {
+			fn(i);
+		}
+		return;
+	}
+
+	// chunks are handed out through a shared counter, the helpers and the
+	// calling thread keep grabbing the next one until the range is done. That
+	// way the caller only ever works on its own loop. Helpers stop early when
+	// their session holds more workers than its share, the caller always
+	// finishes the range.
+	size_t chunks = (end - begin + grain - 1) / grain;
+	std::atomic<size_t> next_chunk{0};
+	auto work = [this, &fn, &next_chunk, begin, end, grain, chunks](bool helper) {
+		size_t chunk;
+		while ((chunk = next_chunk++) < chunks) {
+			size_t chunk_begin = begin + chunk * grain;
+			size_t chunk_end = std::min(end, chunk_begin + grain);
+			for (size_t i = chunk_begin; i < chunk_end; ++i) {
+				fn(i);
+			}
+			if (helper && yield_share()) {
+				return;
+			}
+		}
+	};
+
+	if (priority == TaskPriority::Inherit && !is_worker_thread()) {
+		priority = TaskPriority::Interactive;
+	}
+
+	TaskGroup group(*this, priority);
+	size_t helpers = std::min(chunks - 1, get_fair_share());
+	for (size_t i = 0; i < helpers; ++i) {
+		group.run([&work]() { work(true); });
+	}
+	work(false);
+	group.wait();
 }
@@ -1,12 +1,74 @@
 #include <core/Tiler.hpp>
 
+cv::Mat TilePlan::View(size_t i) const {
+	const cv::Rect &rect = rects[i];
+	return padded(cv::Rect(rect.x + offset.x, rect.y + offset.y, rect.width, rect.height));
+}
+
+void TilePlan::Pack(size_t i, void *dst) const {
+	cv::Mat packed(tileSize, tileSize, padded.type(), dst);
+	View(i).copyTo(packed);
+}
+
 std::vector<Tile> Tiler::CreateTiles(const cv::Mat &image, const TileConfig &config) {
+	TilePlan plan = PlanTiles(image, config);
+	std::vector<Tile> tiles;
+	tiles.reserve(plan.Size());
+	for (size_t i = 0; i < plan.Size(); i++) {
+		tiles.push_back({plan.View(i), plan.Position(i)});
+	}
+	return tiles;
+}
+
+TilePlan Tiler::PlanTiles(const cv::Mat &image, const TileConfig &config) {
+	TilePlan plan;
+	plan.tileSize = config.tileSize;
+	if (image.empty())
+		return plan;
+	plan.rects = TileRects(image.size(), config);
+	if (plan.rects.empty())
+		return plan;
+
+	// the grid is regular, the first and last tile tell how far it reaches
+	// past the image. Out of the image is zero, like the tiles always were.
+	const cv::Rect &first = plan.rects.front();
+	const cv::Rect &last = plan.rects.back();
+	int top = std::max(0, -first.y);
+	int left = std::max(0, -first.x);
+	int bottom = std::max(0, last.y + last.height - image.rows);
+	int right = std::max(0, last.x + last.width - image.cols);
+	cv::copyMakeBorder(image, plan.padded, top, bottom, left, right, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+	plan.offset = cv::Point(left, top);
+	return plan;
+}
+
+std::vector<cv::Rect> Tiler::TileRects(const cv::Size &imageSize, const TileConfig &config) {
+	std::vector<cv::Rect> rects;
+	int tileSize = config.tileSize;
+
+	// the same grids as CreateCroppedTiles and CreateBlendedTiles
+	int start = 0, step = 0;
 	if (config.type == TileType::Cropped) {
-		return CreateCroppedTiles(image, config);
+		start = config.includeOutside ? -(tileSize - config.centerSize) / 2 : 0;
+		step = config.centerSize;
 	} else if (config.type == TileType::Blended) {
-		return CreateBlendedTiles(image, config);
+		step = tileSize - config.overlap;
 	}
-	return {};
+	if (step <= 0)
+		return rects;
+
+	int rows = (imageSize.height - start + step - 1) / step;
+	int cols = (imageSize.width - start + step - 1) / step;
+	if (rows <= 0 || cols <= 0)
+		return rects;
+
+	rects.reserve(rows * cols);
+	for (int row = 0; row < rows; row++) {
+		for (int col = 0; col < cols; col++) {
+			rects.emplace_back(start + col * step, start + row * step, tileSize, tileSize);
+		}
+	}
+	return rects;
 }
 
 cv::Mat Tiler::StitchTiles(const std::vector<Tile> &tiles, const TileConfig &config, const cv::Size &originalSize) {
@@ -18,65 +80,6 @@ cv::Mat Tiler::StitchTiles(const std::vector<Tile> &tiles, const TileConfig &con
 	return {};
 }
 
-std::vector<Tile> Tiler::CreateCroppedTiles(const cv::Mat &image, const TileConfig &config) {
-	auto tileSize = config.tileSize;
-	auto centerSize = config.centerSize;
-	auto includeOutside = config.includeOutside;
-
-	int height = image.rows;
-	int width = image.cols;
-	int centerInset = (tileSize - centerSize) / 2;
-	std::vector<Tile> tiles;
-
-	int y0 = includeOutside ? -centerInset : 0;
-	for (int y = y0; y < height; y += centerSize) {
-		for (int x = y0; x < width; x += centerSize) {
-			int yStart = std::max(y, 0);
-			int xStart = std::max(x, 0);
-			int yEnd = std::min(y + tileSize, height);
-			int xEnd = std::min(x + tileSize, width);
-
-			int shiftY = yStart - y;
-			int shiftX = xStart - x;
-
-			cv::Mat roi = image(cv::Range(yStart, yEnd), cv::Range(xStart, xEnd));
-			cv::Mat tile;
-			if (roi.rows != tileSize || roi.cols != tileSize) {
-				tile = cv::Mat::zeros(tileSize, tileSize, image.type());
-				roi.copyTo(tile(cv::Rect(shiftX, shiftY, roi.cols, roi.rows)));
-			} else {
-				tile = roi.clone();
-			}
-
-			tiles.push_back({tile, cv::Point(x, y)});
-		}
-	}
-	return tiles;
-}
-
-std::vector<Tile> Tiler::CreateBlendedTiles(const cv::Mat &image, const TileConfig &config) {
-	auto tileSize = config.tileSize;
-	auto overlap = config.overlap;
-
-	std::vector<Tile> tiles;
-	int h = image.rows, w = image.cols;
-	for (int y = 0; y < h; y += tileSize - overlap) {
-		for (int x = 0; x < w; x += tileSize - overlap) {
-			int yEnd = std::min(y + tileSize, h);
-			int xEnd = std::min(x + tileSize, w);
-			cv::Rect roi(x, y, xEnd - x, yEnd - y);
-			cv::Mat tile = image(roi);
-			if (tile.rows != tileSize || tile.cols != tileSize) {
-				cv::Mat padded = cv::Mat::zeros(tileSize, tileSize, image.type());
-				tile.copyTo(padded(cv::Rect(0, 0, tile.cols, tile.rows)));
-				tile = padded;
-			}
-			tiles.push_back({tile, cv::Point(x, y)});
-		}
-	}
-	return tiles;
-}
-
 cv::Mat Tiler::StitchCroppedTiles(const std::vector<Tile> &tiles, const cv::Size &originalSize, const TileConfig &cfg) {
 	if (tiles.empty())
 		return cv::Mat();
@@ -87,7 +90,8 @@ cv::Mat Tiler::StitchCroppedTiles(const std::vector<Tile> &tiles, const cv::Size
 	int W = originalSize.width;
 	int H = originalSize.height;
 
-	cv::Mat result(H, W, CV_8UC4, cv::Scalar(0, 0, 0, 0));
+	// the result has the same type as the tiles (gray, float, BGRA, ...)
+	cv::Mat result(H, W, tiles[0].data.type(), cv::Scalar::all(0));
 
 	for (auto &tile : tiles) {
 		int x = tile.position.x, y = tile.position.y;
@@ -135,17 +139,10 @@ cv::Mat Tiler::StitchCroppedTiles(const std::vector<Tile> &tiles, const cv::Size
 		cv::Mat src = tile.data(srcR);
 		cv::Mat dst = result(dstR);
 
-		if (src.type() == CV_32F) {
-			// single-channel float → bgra
-			cv::Mat u8, bgra;
-			src.convertTo(u8, CV_8U, 255.0f);
-			cv::cvtColor(u8, bgra, cv::COLOR_GRAY2BGRA);
-			bgra.copyTo(dst);
-		} else if (src.type() == CV_8UC4) {
-			// already bgra
+		if (src.type() == result.type()) {
 			src.copyTo(dst);
 		}
-		// else: skip unexpected types
+		// else: skip tiles that don't match the others
 	}
 
 	return result;
@@ -160,8 +157,9 @@ cv::Mat Tiler::StitchBlendedTiles(const std::vector<Tile> &tiles, const cv::Size
 	int W = originalSize.width;
 	int H = originalSize.height;
 
-	// determine channel count from first tile
+	// determine channel count and output type from first tile
 	int ch = tiles[0].data.channels();
+	int type = tiles[0].data.type();
 
 	// accumulators
 	cv::Mat acc(H, W, CV_MAKETYPE(CV_32F, ch), cv::Scalar::all(0));
@@ -175,14 +173,12 @@ cv::Mat Tiler::StitchBlendedTiles(const std::vector<Tile> &tiles, const cv::Size
 		cv::Rect dstR(x, y, xEnd - x, yEnd - y);
 		cv::Rect srcR(0, 0, dstR.width, dstR.height);
 
-		// convert to float (depth only)
+		if (tile.data.type() != type)
+			continue;
+
+		// convert to float (depth only), blended in the tiles' own value range
 		cv::Mat tf;
-		if (tile.data.type() == CV_8UC4) {
-			tile.data.convertTo(tf, CV_32F, 1.0 / 255.0);
-		}
-		else if (tile.data.type() == CV_32F) {
-			tf = tile.data;
-		}
+		tile.data.convertTo(tf, CV_32F);
 
 		// build weight mask
 		cv::Mat wm(dstR.height, dstR.width, CV_32F, 1.0f);
@@ -248,18 +244,8 @@ cv::Mat Tiler::StitchBlendedTiles(const std::vector<Tile> &tiles, const cv::Size
 	// normalize
 	cv::divide(acc, wC, acc);
 
-	// after dividing acc by weights:
-	cv::Mat u8;
-	acc.convertTo(u8, CV_8U, 255.0f); // FLOAT → UINT8
-
-	cv::Mat out(originalSize.height, originalSize.width, CV_8UC4);
-
-	if (ch == 1) {
-		cv::cvtColor(u8, out, cv::COLOR_GRAY2BGRA);
-	} else if (ch == 4) {
-		// u8 already has 4 channels in BGRA order
-		out = u8;
-	}
-
+	// back to the tiles' type
+	cv::Mat out;
+	acc.convertTo(out, type);
 	return out;
 }
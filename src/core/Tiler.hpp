@@ -30,15 +30,40 @@ struct TileConfig {
 	bool includeOutside;
 };
 
+// The tiles of an image as rects into one padded copy of it. Only the padded
+// copy is made up front (about the size of the image), a tile is copied when a
+// consumer packs it into its own buffer, e.g. the input batch of a model.
+struct TilePlan {
+	// the image with a zero border wherever tiles reach past it
+	cv::Mat padded;
+	// where the image starts in `padded`
+	cv::Point offset;
+	int tileSize = 0;
+	// in image coordinates, the same as Tiler::TileRects
+	std::vector<cv::Rect> rects;
+
+	size_t Size() const { return rects.size(); }
+	cv::Point Position(size_t i) const { return cv::Point(rects[i].x, rects[i].y); }
+	// tile i as a view into `padded`, nothing is copied
+	cv::Mat View(size_t i) const;
+	// Copies tile i to dst as tileSize rows of tileSize pixels, back to back
+	void Pack(size_t i, void *dst) const;
+};
+
 class Tiler {
       public:
+	// The tiles are views into one padded copy of the image (see PlanTiles)
+	// and keep it alive. They overlap, so they must not be written in place.
 	static std::vector<Tile> CreateTiles(const cv::Mat &image, const TileConfig &config);
+	static TilePlan PlanTiles(const cv::Mat &image, const TileConfig &config);
+	// Where CreateTiles would cut the tiles from an image of this size, without
+	// copying anything. Rects can reach past the image, that part is padding.
+	static std::vector<cv::Rect> TileRects(const cv::Size &imageSize, const TileConfig &config);
+	// the stitched image has the same type as the tiles
 	static cv::Mat StitchTiles(const std::vector<Tile> &tiles, const TileConfig &config,
 				   const cv::Size &originalSize);
 
       private:
-	static std::vector<Tile> CreateCroppedTiles(const cv::Mat &image, const TileConfig &config);
-	static std::vector<Tile> CreateBlendedTiles(const cv::Mat &image, const TileConfig &config);
 	static cv::Mat StitchCroppedTiles(const std::vector<Tile> &tiles, const cv::Size &originalSize,
 					  const TileConfig &config);
 	static cv::Mat StitchBlendedTiles(const std::vector<Tile> &tiles, const cv::Size &originalSize,
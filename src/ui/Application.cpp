@@ -9,6 +9,36 @@
 #include <ImGuiImpl.h>
 #include <utils.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+
+// longest the loop sleeps without input or redraw requests
+static constexpr double kIdleTimeout = 0.5;
+// frames drawn after input, ImGui needs a few to settle (hover, popups, navigation)
+static constexpr int kSettleFrames = 3;
+
+// earliest requested redraw in steady clock nanoseconds, max if there's none
+static std::atomic<int64_t> s_redraw_deadline = std::numeric_limits<int64_t>::max();
+static std::atomic<bool> s_waiting = false;
+
+static int64_t Now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+	    .count();
+}
+
+void Application::RequestRedraw(double delay) {
+	int64_t deadline = Now() + (int64_t)(delay * 1e9);
+	int64_t current = s_redraw_deadline.load();
+	while (deadline < current && !s_redraw_deadline.compare_exchange_weak(current, deadline)) {
+	}
+	// the loop may be asleep with a later timeout, wake it to pick this one up
+	if (deadline < current && s_waiting) {
+		glfwPostEmptyEvent();
+	}
+}
+
 Application::Application() : m_window(nullptr), m_showWelcome(true), m_assetsFound(false), m_dockspaceID(0) {}
 
 Application::~Application() { Shutdown(); }
@@ -96,13 +126,39 @@ void Application::InitializeImGui() {
 }
 
 void Application::Run() {
+	int settle_frames = kSettleFrames;
 	while (!glfwWindowShouldClose(m_window)) {
 		// Set the default background and clear the screen
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		// Check for events
-		glfwPollEvents();
+		// Check for events, sleeping until there are some or a redraw is due
+		// once the UI has settled
+		if (settle_frames > 0) {
+			settle_frames--;
+			glfwPollEvents();
+		} else {
+			// set before the deadline is read, so a request in between wakes the wait
+			s_waiting = true;
+			int64_t now = Now();
+			double timeout = std::clamp((double)(s_redraw_deadline.load() - now) / 1e9, 0.0, kIdleTimeout);
+			if (timeout > 0.0) {
+				glfwWaitEventsTimeout(timeout);
+				// woken early by input (or a new redraw request)
+				if (Now() - now < (int64_t)(timeout * 1e9)) {
+					settle_frames = kSettleFrames;
+				}
+			} else {
+				glfwPollEvents();
+			}
+			s_waiting = false;
+		}
+		// this frame is the requested redraw, anything that needs another
+		// one asks again while it's drawn
+		int64_t due = s_redraw_deadline.load();
+		if (due <= Now()) {
+			s_redraw_deadline.compare_exchange_strong(due, std::numeric_limits<int64_t>::max());
+		}
 
 		// Begin the ImGui frame
 		ImGuiBeginFrame();
@@ -229,14 +285,15 @@ void Application::RenderWelcomeScreen() {
 char image_folder_buffer[1024];
 void Application::RenderFolderSelector() {
 #ifdef __APPLE__
-	ImGui::InputTextWithHint("##image_folder", "Enter image folder path", image_folder_buffer, 1024);
+	ImGui::InputTextWithHint("##image_folder", "Enter image folder or TIFF stack path", image_folder_buffer, 1024);
 
 	// String from image_folder_buffer
 	std::string image_folder(image_folder_buffer);
 
 	if (ImGui::Button("Load Images")) {
-		if (!image_folder.empty() && std::filesystem::is_directory(image_folder) &&
-		    utils::DirectoryContainsTiff(image_folder)) {
+		if (!image_folder.empty() && ((std::filesystem::is_directory(image_folder) &&
+					       utils::DirectoryContainsTiff(image_folder)) ||
+					      utils::IsTiffFile(image_folder))) {
 			m_imageSets.emplace_back(std::make_unique<ImageSet>(image_folder));
 		}
 	}
@@ -246,9 +303,9 @@ void Application::RenderFolderSelector() {
 	ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(0.28f, 0.56f, 1.0f, 0.9f));
 	ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4(0.28f, 0.56f, 1.0f, 1.0f));
 
-	// Center the button horizontally
+	// Center the buttons horizontally
 	float buttonWidth = 150.0f;
-	ImGui::SetCursorPosX((ImGui::GetWindowWidth() - buttonWidth) * 0.5f);
+	ImGui::SetCursorPosX((ImGui::GetWindowWidth() - buttonWidth * 2 - ImGui::GetStyle().ItemSpacing.x) * 0.5f);
 
 	if (ImGui::Button("Select Folder", ImVec2(buttonWidth, 35))) {
 		std::string folder_path = utils::OpenFileDialog(".", "Choose a Folder to Load", true);
@@ -257,6 +314,14 @@ void Application::RenderFolderSelector() {
 			m_imageSets.emplace_back(std::make_unique<ImageSet>(folder_path));
 		}
 	}
+	ImGui::SameLine();
+	// multi-page tiffs are loaded like a folder, one frame per page
+	if (ImGui::Button("Select TIFF Stack", ImVec2(buttonWidth, 35))) {
+		std::string stack_path = utils::OpenFileDialog(".", "Choose a TIFF Stack to Load", false, "tif");
+		if (!stack_path.empty() && utils::IsTiffFile(stack_path)) {
+			m_imageSets.emplace_back(std::make_unique<ImageSet>(stack_path));
+		}
+	}
 
 	ImGui::PopStyleColor(3);
 #endif
@@ -281,6 +346,7 @@ void Application::RenderImageSets() {
 void Application::Shutdown() {
 	// Clean up image sets
 	m_imageSets.clear();
+	Texture::ReleaseStreamingBuffers();
 
 	// Destroy GLFW window and terminate GLFW
 	if (m_window) {
@@ -23,6 +23,13 @@ class Application {
 	// Clean up resources
 	void Shutdown();
 
+	// The main loop sleeps until there's input or a redraw is due. Anything
+	// that changes on screen by itself (progress, playback, finished jobs)
+	// asks for a redraw `delay` seconds from now. Thread safe.
+	static void RequestRedraw(double delay = 0.0);
+	// how often running jobs redraw for their progress
+	static constexpr double kProgressInterval = 1.0 / 30.0;
+
       private:
 	// Initialize GLFW and OpenGL
 	bool InitializeGLFW();
@@ -1,10 +1,12 @@
 #include <ui/ImageSet.h>
+#include <ui/Application.h>
 
 #include <core/CrackDetector.hpp>
 #include <core/DeformationAnalysisInterface.hpp>
 #include <core/DenoiseInterface.hpp>
 #include <core/FeatureTracker.hpp>
 #include <core/ImageAnalysis.hpp>
+#include <core/ThreadPool.hpp>
 
 #include <utils.h>
 
@@ -13,44 +15,64 @@
 #include <opencv2/opencv.hpp>
 
 #include <algorithm>
+#include <chrono>
 #include <format>
 #include <string>
+#include <unordered_set>
 
 #define CALC_SLIDER_SIZE(text) (ImGui::GetContentRegionAvail().x - ImGui::CalcTextSize(#text).x) - 5
 
 int ImageSet::m_id_counter = 0;
 
-ImageSet::ImageSet(const std::string_view &folder_path) : m_folder_path(folder_path) {
+ImageSet::ImageSet(const std::string_view &folder_path)
+    : m_folder_path(folder_path), m_preprocessing_tab(m_processed, m_processed_textures) {
 	m_window_id = m_id_counter++;
 	m_window_name = folder_path.find_last_of('/') == std::string::npos
 			    ? folder_path
 			    : folder_path.substr(folder_path.find_last_of('/') + 1);
 	m_window_name = std::format("{} {}", m_window_name, m_window_id);
 
+	SessionScope session(m_session);
 	LoadImages();
 
 	m_point_texture = Texture();
-
-	m_preprocessing_tab = PreprocessingTab(m_textures, m_processed_textures);
 }
 
-ImageSet::~ImageSet() { free(m_point_image); }
+ImageSet::~ImageSet() {
+	// the loader writes into the frame cache, it has to stop before that goes away
+	m_load_cancel_token.cancel();
+	if (m_load_future.valid()) {
+		m_load_future.wait();
+	}
+	// and the deformation analysis works on m_processing_frames
+	if (m_deformation_job) {
+		m_deformation_job->Cancel();
+		m_deformation_job->Wait();
+	}
+	free(m_point_image);
+}
 
 // display the image set window and the tabs
 void ImageSet::Display() {
+	SessionScope session(m_session);
 	ImGui::Begin(m_window_name.c_str(), &m_open);
 
-	// Check if processing is happening in the preprocessing tab
-	bool isPreprocessProcessing = m_preprocessing_tab.IsProcessing();
-	bool isDeformationProcessing = DeformationAnalysisInterface::IsProcessing();
+	AddLoadedFrames();
+	if (m_loading) {
+		int loaded = m_load_queue->loaded, total = m_load_queue->total;
+		ImGui::Text("Loading frames %d/%d", loaded, total);
+		ImGui::ProgressBar(total > 0 ? (float)loaded / total : 0.0f, ImVec2(-1, 0), "");
+	}
 
-	// Check if an async processing task has completed
-	if (!isDeformationProcessing && m_processing_future && m_processing_future->valid()) {
-		// Poll the future with zero timeout to check if it's done without blocking
-		auto status = m_processing_future->wait_for(std::chrono::seconds(0));
-		if (status == std::future_status::ready) {
-			auto result = m_processing_future->get();
-			m_model_ok = result;
+	// Check if the deformation analysis has finished, without blocking
+	if (m_deformation_job && m_deformation_job->IsFinished()) {
+		if (m_deformation_job->IsCancelled()) {
+			// cancelled, drop the partial results and leave the frames as they were
+			m_processing_data.clear();
+			m_processing_frames.clear();
+			m_output_tiles.clear();
+		} else {
+			m_model_ok = m_deformation_job->GetResult();
 
 			// Create textures for the output tiles
 			for (auto &tile : m_output_tiles) {
@@ -63,25 +85,33 @@ void ImageSet::Display() {
 			}
 
 			// Create full image texture if tiles are available
-			if (!m_output_tiles.empty() && !m_processed_textures.empty()) {
+			if (!m_output_tiles.empty() && !m_processing_data.empty()) {
 				m_full_image_texture = std::make_shared<Texture>();
-				m_full_image_texture->Load(m_processing_frames[0], m_processed_textures[0]->GetWidth(),
-							   m_processed_textures[0]->GetHeight());
+				m_full_image_texture->Load(m_processing_data[0]);
 			}
 
-			utils::LoadDataIntoTexturesAndFree(m_processed_textures, m_processing_frames,
-							   m_processed_textures[0]->GetWidth(),
-							   m_processed_textures[0]->GetHeight());
+			for (size_t i = 0; i < m_processing_data.size() && i < m_processed.Size(); i++) {
+				m_processed.Set(i, std::move(m_processing_data[i]));
+			}
 
+			m_processing_data.clear();
 			m_processing_frames.clear();
 		}
+		m_deformation_job.reset();
+	}
+
+	// Check if processing is happening in the preprocessing tab
+	bool isPreprocessProcessing = m_preprocessing_tab.IsProcessing();
+	bool isDeformationProcessing = m_deformation_job.has_value();
+
+	// progress bars have to move without input, the main loop sleeps otherwise
+	if (isPreprocessProcessing || isDeformationProcessing) {
+		Application::RequestRedraw(Application::kProgressInterval);
 	}
 
 	// Start tab bar
 	ImGui::BeginTabBar("Image Set Tabs");
 
-	bool changed = false;
-
 	// If not processing, show the image comparison tab
 	if (!isPreprocessProcessing && !isDeformationProcessing) {
 		DisplayImageComparisonTab();
@@ -94,8 +124,10 @@ void ImageSet::Display() {
 	}
 
 	// if we aren't doing deformation analysis, show the preprocessing tab
-	if (!isDeformationProcessing)
-		m_preprocessing_tab.DisplayPreprocessingTab(changed);
+	if (!isDeformationProcessing) {
+		m_preprocessing_tab.SetLoading(m_loading);
+		m_preprocessing_tab.DisplayPreprocessingTab();
+	}
 
 	if (isPreprocessProcessing || isDeformationProcessing) {
 		ImGui::PopStyleColor(3);
@@ -111,31 +143,91 @@ void ImageSet::Display() {
 		DisplayImageAnalysisTab();
 	}
 
-	// only necessary when we modify the vector by changing its size (this
-	// only happens in the preprocessing tab)
-	if (changed) {
-		m_preprocessing_tab.GetProcessedTextures(m_processed_textures);
-	}
-
 	ImGui::EndTabBar();
+
+	// upload whatever the tabs changed, before the frame is rendered
+	m_textures.Sync(m_frames);
+	m_processed_textures.Sync(m_processed);
+
 	ImGui::End();
 }
 
+// exports are lossless but compressed, they're often several GB otherwise
+static const io::TiffWriteOptions kExportTiffOptions = {io::TiffCompression::Deflate};
+
+// how long a UI frame may spend adding loaded frames
+static constexpr auto kLoadBudget = std::chrono::milliseconds(4);
+
 void ImageSet::LoadImages() {
 	PROFILE_FUNCTION();
 
-	std::vector<uint32_t *> images;
-	int width, height;
-	io::LoadTiffFolder(m_folder_path.c_str(), images, width, height);
-
-	for (auto &image : images) {
-		std::shared_ptr<Texture> t = std::make_shared<Texture>();
-		t->Load(image, width, height);
-		m_textures.push_back(t);
-		std::shared_ptr<Texture> t2 = std::make_shared<Texture>();
-		t2->Load(image, width, height);
-		m_processed_textures.push_back(t2);
-		free(image);
+	// frames are decoded on the pool by a loader task, so the window shows up
+	// right away and the frames appear as AddLoadedFrames picks them up. They
+	// go through the frame cache, so opening the folder again maps the decoded
+	// frames instead of decoding the tiffs and the store only holds views.
+	m_loading = true;
+	auto queue = m_load_queue;
+	CancellationToken token = m_load_cancel_token;
+	m_load_future = ThreadPool::GetThreadPool().enqueue(TaskPriority::Normal, [this, queue, token]() {
+		std::string cache_path = FrameCache::DefaultPath(m_folder_path.c_str());
+		bool result = io::LoadTiffFolderCached(
+		    m_folder_path.c_str(), cache_path.c_str(), m_frame_cache,
+		    [&](int index, Frame frame) {
+			    std::unique_lock<std::mutex> lock(queue->mutex);
+			    queue->frames.push_back(std::move(frame));
+			    Application::RequestRedraw(Application::kProgressInterval);
+		    },
+		    [&](int loaded, int total) {
+			    queue->loaded = loaded;
+			    queue->total = total;
+			    Application::RequestRedraw(Application::kProgressInterval);
+		    },
+		    token);
+		Application::RequestRedraw();
+		return result;
+	});
+}
+
+void ImageSet::AddLoadedFrames() {
+	if (!m_loading) {
+		return;
+	}
+	PROFILE_FUNCTION();
+
+	// checked before the queue, the loader has queued everything once it's done
+	bool done = m_load_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+
+	// the originals stay on the CPU in the (gray) store, the textures are
+	// only uploaded when a frame is drawn
+	auto start = std::chrono::steady_clock::now();
+	bool drained = false;
+	while (std::chrono::steady_clock::now() - start < kLoadBudget) {
+		Frame frame;
+		{
+			std::unique_lock<std::mutex> lock(m_load_queue->mutex);
+			if (m_load_queue->frames.empty()) {
+				drained = true;
+				break;
+			}
+			frame = std::move(m_load_queue->frames.front());
+			m_load_queue->frames.pop_front();
+		}
+		if (m_frames.Add(std::move(frame)) && !m_processed.Add(m_frames.Get(m_frames.Size() - 1))) {
+			// the stores have to stay aligned, nothing changes the size of
+			// the processed frames while loading so this shouldn't happen
+			printf("Frame %zu doesn't fit the processed frames, dropping it\n", m_frames.Size() - 1);
+			m_frames.Remove(m_frames.Size() - 1);
+		}
+	}
+
+	if (!drained) {
+		// out of budget, the rest is added over the next frames
+		Application::RequestRedraw();
+	} else if (done) {
+		if (!m_load_future.get() && !m_load_cancel_token.is_cancelled()) {
+			printf("Failed to load images from %s\n", m_folder_path.c_str());
+		}
+		m_loading = false;
 	}
 }
 
@@ -154,7 +246,7 @@ void ImageSet::DisplayImageComparisonTab() {
 				// Export options for the current frame
 				if (ImGui::BeginMenu("Export Current Frame")) {
 					if (ImGui::MenuItem("Original as TIFF")) {
-						if (!m_textures.empty() && m_current_frame < m_textures.size()) {
+						if (!m_textures.Empty() && m_current_frame < m_textures.Size()) {
 							std::string path = utils::SaveFileDialog(".",
 												 "Save "
 												 "Original "
@@ -162,21 +254,16 @@ void ImageSet::DisplayImageComparisonTab() {
 												 "TIFF",
 												 "tif");
 							if (!path.empty()) {
-								uint32_t *data = new uint32_t
-								    [m_textures[m_current_frame]->GetWidth() *
-								     m_textures[m_current_frame]->GetHeight()];
-								m_textures[m_current_frame]->GetData(data);
-								io::WriteTiff(path.c_str(), data,
-									      m_textures[m_current_frame]->GetWidth(),
-									      m_textures[m_current_frame]->GetHeight());
-								delete[] data;
+								// straight from the store, in the original bit depth
+								io::WriteTiff(path.c_str(), m_frames.Get(m_current_frame),
+									      kExportTiffOptions);
 							}
 						}
 					}
 
 					if (ImGui::MenuItem("Processed as TIFF")) {
-						if (!m_processed_textures.empty() &&
-						    m_current_frame < m_processed_textures.size()) {
+						if (!m_processed_textures.Empty() &&
+						    m_current_frame < m_processed_textures.Size()) {
 							std::string path = utils::SaveFileDialog(".",
 												 "Save "
 												 "Processed "
@@ -184,17 +271,9 @@ void ImageSet::DisplayImageComparisonTab() {
 												 "TIFF",
 												 "tif");
 							if (!path.empty()) {
-								uint32_t *data =
-								    new uint32_t[m_processed_textures[m_current_frame]
-										     ->GetWidth() *
-										 m_processed_textures[m_current_frame]
-										     ->GetHeight()];
-								m_processed_textures[m_current_frame]->GetData(data);
-								io::WriteTiff(
-								    path.c_str(), data,
-								    m_processed_textures[m_current_frame]->GetWidth(),
-								    m_processed_textures[m_current_frame]->GetHeight());
-								delete[] data;
+								io::WriteTiff(path.c_str(),
+									      m_processed.Get(m_current_frame),
+									      kExportTiffOptions);
 							}
 						}
 					}
@@ -208,22 +287,9 @@ void ImageSet::DisplayImageComparisonTab() {
 											   "Choose a Folder to "
 											   "Save Original Images",
 											   true);
-						if (!folder.empty() && !m_textures.empty()) {
-							uint32_t *data = new uint32_t[m_textures[0]->GetWidth() *
-										      m_textures[0]->GetHeight()];
-							for (int i = 0; i < m_textures.size(); i++) {
-								char path[256];
-								sprintf(path,
-									"%s/"
-									"original_"
-									"frame_%d."
-									"tif",
-									folder.c_str(), i);
-								m_textures[i]->GetData(data);
-								io::WriteTiff(path, data, m_textures[i]->GetWidth(),
-									      m_textures[i]->GetHeight());
-							}
-							delete[] data;
+						if (!folder.empty() && !m_frames.Empty()) {
+							io::WriteTiffFolder(folder.c_str(), "original_frame_%d.tif",
+									    m_frames.Frames(), kExportTiffOptions);
 						}
 					}
 
@@ -232,35 +298,44 @@ void ImageSet::DisplayImageComparisonTab() {
 											   "Choose a Folder to "
 											   "Save Processed Images",
 											   true);
-						if (!folder.empty() && !m_processed_textures.empty()) {
-							uint32_t *data =
-							    new uint32_t[m_processed_textures[0]->GetWidth() *
-									 m_processed_textures[0]->GetHeight()];
-							for (int i = 0; i < m_processed_textures.size(); i++) {
-								char path[256];
-								sprintf(path,
-									"%s/"
-									"processed_"
-									"frame_%d."
-									"tif",
-									folder.c_str(), i);
-								m_processed_textures[i]->GetData(data);
-								io::WriteTiff(path, data,
-									      m_processed_textures[i]->GetWidth(),
-									      m_processed_textures[i]->GetHeight());
-							}
-							delete[] data;
+						if (!folder.empty() && !m_processed_textures.Empty()) {
+							io::WriteTiffFolder(folder.c_str(), "processed_frame_%d.tif",
+									    m_processed.Frames(), kExportTiffOptions);
 						}
 					}
 
+					if (ImGui::MenuItem("Original Sequence as TIFF Stack")) {
+						std::string path = utils::SaveFileDialog(".",
+											 "Save Original "
+											 "Sequence as TIFF Stack",
+											 "tif");
+						if (!path.empty() && !m_frames.Empty()) {
+							io::WriteTiffStack(path.c_str(), m_frames.Frames(), kExportTiffOptions);
+						}
+					}
+
+					if (ImGui::MenuItem("Processed Sequence as TIFF Stack")) {
+						std::string path = utils::SaveFileDialog(".",
+											 "Save Processed "
+											 "Sequence as TIFF Stack",
+											 "tif");
+						if (!path.empty() && !m_processed_textures.Empty()) {
+							io::WriteTiffStack(path.c_str(), m_processed.Frames(),
+									   kExportTiffOptions);
+						}
+					}
+
+					ImGui::MenuItem("One Palette for the Whole GIF", nullptr, &m_gif_global_palette);
 					if (ImGui::MenuItem("Processed Sequence as GIF")) {
 						std::string path = utils::SaveFileDialog(".",
 											 "Save Processed "
 											 "Sequence as GIF",
 											 "gif");
-						if (!path.empty() && !m_processed_textures.empty()) {
-							io::WriteGIFOfImageSet(path.c_str(), m_processed_textures, 40,
-									       0);
+						if (!path.empty() && !m_processed_textures.Empty()) {
+							io::GifWriteOptions options;
+							options.delay = 40;
+							options.global_palette = m_gif_global_palette;
+							io::WriteGif(path.c_str(), m_processed.Frames(), options);
 						}
 					}
 					ImGui::EndMenu();
@@ -278,7 +353,7 @@ void ImageSet::DisplayImageComparisonTab() {
 		ImGui::SeparatorText("Playback Controls");
 
 		// Frame navigation controls
-		int max_frame = (int)std::max(m_textures.size(), m_processed_textures.size()) - 1;
+		int max_frame = (int)std::max(m_textures.Size(), m_processed_textures.Size()) - 1;
 
 		// Keep within bounds if frames were removed
 		if (m_current_frame > max_frame)
@@ -346,16 +421,19 @@ void ImageSet::DisplayImageComparisonTab() {
 		if (ImGui::Button("Reset Processed Images", ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
 			PROFILE_SCOPE(ResetProcessedImages);
 
-			while (m_textures.size() > m_processed_textures.size())
-				m_processed_textures.push_back(std::make_shared<Texture>());
-			ImVec2 size = ImVec2(m_textures[0]->GetWidth(), m_textures[0]->GetHeight());
-			uint32_t *data = (uint32_t *)malloc(size.x * size.y * sizeof(uint32_t));
-			for (int i = 0; i < m_textures.size(); i++) {
-				m_textures[i]->GetData(data);
-				m_processed_textures[i]->Load(data, (int)size.x, (int)size.y);
+			// views of the originals again. Frames that still are one keep their
+			// version, so only the processed ones get uploaded
+			while (m_processed.Size() > m_frames.Size())
+				m_processed.Remove(m_processed.Size() - 1);
+			for (int i = 0; i < m_frames.Size(); i++) {
+				const Frame &original = m_frames.Get(i);
+				if (i >= m_processed.Size()) {
+					m_processed.Add(original);
+				} else if (m_processed.Get(i).data.data != original.data.data ||
+					   m_processed.Get(i).data.size != original.data.size) {
+					m_processed.Set(i, original);
+				}
 			}
-			m_preprocessing_tab.SetProcessedTextures(m_processed_textures);
-			free(data);
 		}
 
 		// Help section
@@ -370,7 +448,7 @@ void ImageSet::DisplayImageComparisonTab() {
 		ImGui::BeginChild("Images", ImVec2(0, 0), true);
 
 		// Image navigation bar at the top
-		if (!m_textures.empty() && !m_processed_textures.empty()) {
+		if (!m_textures.Empty() && !m_processed_textures.Empty()) {
 			// Frame navigation strip at the top
 			ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(4, 4));
 
@@ -413,10 +491,10 @@ void ImageSet::DisplayImageComparisonTab() {
 
 		// Left sequence (original)
 		ImGui::SeparatorText("Original Sequence");
-		if (!m_textures.empty() && m_current_frame < m_textures.size()) {
+		if (!m_textures.Empty() && m_current_frame < m_textures.Size()) {
 			// Calculate the available size
 			ImVec2 avail = ImGui::GetContentRegionAvail();
-			ImVec2 img_size = ImVec2(m_textures[0]->GetWidth(), m_textures[0]->GetHeight());
+			ImVec2 img_size = ImVec2(m_textures.Width(0), m_textures.Height(0));
 			float aspect = img_size.x / img_size.y;
 
 			// Scale the image to fit the available width
@@ -429,7 +507,8 @@ void ImageSet::DisplayImageComparisonTab() {
 			ImGui::SetCursorPos(centered_pos);
 
 			// Display image
-			ImGui::Image(m_textures[m_current_frame]->GetID(), display_size);
+			ImGui::Image(m_textures.Get(m_current_frame)->GetID(), display_size);
+			m_textures.Prefetch(m_current_frame);
 
 			// Image information
 			ImGui::SetCursorPosX(cursor_pos.x);
@@ -442,11 +521,10 @@ void ImageSet::DisplayImageComparisonTab() {
 
 		// Right sequence (processed)
 		ImGui::SeparatorText("Processed Sequence");
-		if (!m_processed_textures.empty() && m_current_frame < m_processed_textures.size()) {
+		if (!m_processed_textures.Empty() && m_current_frame < m_processed_textures.Size()) {
 			// Calculate the available size
 			ImVec2 avail = ImGui::GetContentRegionAvail();
-			ImVec2 img_size =
-			    ImVec2(m_processed_textures[0]->GetWidth(), m_processed_textures[0]->GetHeight());
+			ImVec2 img_size = ImVec2(m_processed_textures.Width(0), m_processed_textures.Height(0));
 			float aspect = img_size.x / img_size.y;
 
 			// Scale the image to fit the available width
@@ -459,7 +537,8 @@ void ImageSet::DisplayImageComparisonTab() {
 			ImGui::SetCursorPos(centered_pos);
 
 			// Display image
-			ImGui::Image(m_processed_textures[m_current_frame]->GetID(), display_size);
+			ImGui::Image(m_processed_textures.Get(m_current_frame)->GetID(), display_size);
+			m_processed_textures.Prefetch(m_current_frame);
 
 			// Image information
 			ImGui::SetCursorPosX(cursor_pos.x);
@@ -479,11 +558,12 @@ void ImageSet::DisplayImageComparisonTab() {
 
 			if (current_time - last_time > frame_time) {
 				m_current_frame++;
-				if (m_current_frame >= std::max(m_textures.size(), m_processed_textures.size())) {
+				if (m_current_frame >= std::max(m_textures.Size(), m_processed_textures.Size())) {
 					m_current_frame = 0; // Loop back to start
 				}
 				last_time = current_time;
 			}
+			Application::RequestRedraw(frame_time);
 		}
 
 		// End the child window with the menu bar
@@ -493,11 +573,70 @@ void ImageSet::DisplayImageComparisonTab() {
 	}
 }
 
+void ImageSet::UpdateAnalysis() {
+	std::vector<uint64_t> versions(m_processed.Size());
+	for (int i = 0; i < m_processed.Size(); i++)
+		versions[i] = m_processed.Version(i);
+
+	// no frame changed since the last update
+	if (versions == m_analysis_versions)
+		return;
+
+	PROFILE_FUNCTION();
+
+	const int bins = 256;
+	m_histogram_sum.resize(bins);
+
+	// drop the results of frames that were removed or replaced
+	std::unordered_set<uint64_t> current(versions.begin(), versions.end());
+	for (auto it = m_analysis_cache.begin(); it != m_analysis_cache.end();) {
+		if (current.find(it->first) == current.end()) {
+			for (int j = 0; j < bins; j++)
+				m_histogram_sum[j] -= it->second.histogram[j];
+			m_snr_sum -= it->second.snr;
+			it = m_analysis_cache.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	// only analyze the frames we don't have results for
+	std::vector<int> missing;
+	for (int i = 0; i < m_processed.Size(); i++) {
+		if (m_analysis_cache.find(versions[i]) == m_analysis_cache.end())
+			missing.push_back(i);
+	}
+	std::vector<FrameAnalysis> results(missing.size());
+	ThreadPool::GetThreadPool().parallel_for(0, missing.size(), 1, [&](size_t k) {
+		ImageAnalysis::AnalyzeFrame(m_processed.Get(missing[k]), results[k].histogram, results[k].snr);
+	});
+	for (int k = 0; k < missing.size(); k++) {
+		for (int j = 0; j < bins; j++)
+			m_histogram_sum[j] += results[k].histogram[j];
+		m_snr_sum += results[k].snr;
+		m_analysis_cache.emplace(versions[missing[k]], std::move(results[k]));
+	}
+
+	// rebuild the per-frame views in frame order
+	histograms.resize(versions.size());
+	snrs.resize(versions.size());
+	for (int i = 0; i < versions.size(); i++) {
+		const auto &analysis = m_analysis_cache[versions[i]];
+		histograms[i] = analysis.histogram;
+		snrs[i] = analysis.snr;
+	}
+
+	avg_histogram.resize(bins);
+	for (int j = 0; j < bins; j++)
+		avg_histogram[j] = versions.empty() ? 0.0f : m_histogram_sum[j] / versions.size();
+	avg_snr = versions.empty() ? 0.0f : m_snr_sum / versions.size();
+
+	m_analysis_versions = std::move(versions);
+}
+
 void ImageSet::DisplayImageAnalysisTab() {
-	static uint32_t *s_comparison_image = nullptr;
-	static uint32_t s_ref_image_width = 0, s_ref_image_height = 0;
 	if (ImGui::BeginTabItem("Image Analysis")) {
-		if (m_processed_textures.size() == 0) {
+		if (m_processed_textures.Size() == 0) {
 			ImGui::Text("No images loaded");
 			ImGui::EndTabItem();
 			return;
@@ -505,56 +644,23 @@ void ImageSet::DisplayImageAnalysisTab() {
 
 		// Ensure current frame is within bounds
 		m_analysis_current_frame =
-		    std::clamp(m_analysis_current_frame, 0, (int)m_processed_textures.size() - 1);
-
-		if (s_comparison_image == nullptr ||
-		    s_ref_image_width * s_ref_image_height !=
-			m_processed_textures[0]->GetWidth() * m_processed_textures[0]->GetHeight()) {
-			free(s_comparison_image);
-			s_comparison_image = (uint32_t *)malloc(m_processed_textures[0]->GetWidth() *
-								m_processed_textures[0]->GetHeight() * 4);
-			s_ref_image_width = m_processed_textures[0]->GetWidth();
-			s_ref_image_height = m_processed_textures[0]->GetHeight();
-		}
-		if (m_ref_image == nullptr ||
-		    m_ref_image_width * m_ref_image_height !=
-			m_processed_textures[0]->GetWidth() * m_processed_textures[0]->GetHeight()) {
-			free(m_ref_image);
-			m_ref_image =
-			    new uint32_t[m_processed_textures[0]->GetWidth() * m_processed_textures[0]->GetHeight()];
-			m_ref_image_width = m_processed_textures[0]->GetWidth();
-			m_ref_image_height = m_processed_textures[0]->GetHeight();
-		}
-		m_processed_textures[0]->GetData(s_comparison_image);
-		if (memcmp(m_ref_image, s_comparison_image, m_ref_image_width * m_ref_image_height * 4) != 0) {
-			m_processed_textures[0]->GetData(m_ref_image);
-			histograms.clear();
-			avg_histogram.clear();
-			snrs.clear();
-			avg_snr = 0.0f;
-			std::vector<uint32_t *> frames;
-			utils::GetDataFromTextures(frames, m_processed_textures[0]->GetWidth(),
-						   m_processed_textures[0]->GetHeight(), m_processed_textures);
-			ImageAnalysis::AnalyzeImages(frames, m_ref_image_width, m_ref_image_height, histograms,
-						     avg_histogram, snrs, avg_snr);
-			for (auto &frame : frames) {
-				free(frame);
-			}
-		}
+		    std::clamp(m_analysis_current_frame, 0, (int)m_processed_textures.Size() - 1);
+
+		UpdateAnalysis();
 
 		// Create layout with image on left, controls and histogram on right
 		ImGui::BeginChild("AnalysisControls", ImVec2(250, 0));
 
 		ImGui::SeparatorText("Frame Navigation");
-		if (m_processed_textures.size() > 1) {
+		if (m_processed_textures.Size() > 1) {
 			// Frame slider with text showing current/total frames
-			ImGui::Text("Frame: %d/%d", m_analysis_current_frame + 1, (int)m_processed_textures.size());
+			ImGui::Text("Frame: %d/%d", m_analysis_current_frame + 1, (int)m_processed_textures.Size());
 			ImGui::SetNextItemWidth(220);
 			if (ImGui::SliderInt("##AnalysisFrameSlider", &m_analysis_current_frame, 0,
-					     m_processed_textures.size() - 1, "")) {
+					     m_processed_textures.Size() - 1, "")) {
 				// Keep within bounds
 				m_analysis_current_frame = std::max(
-				    0, std::min(m_analysis_current_frame, (int)m_processed_textures.size() - 1));
+				    0, std::min(m_analysis_current_frame, (int)m_processed_textures.Size() - 1));
 			}
 
 			// Navigation buttons
@@ -564,7 +670,7 @@ void ImageSet::DisplayImageAnalysisTab() {
 			ImGui::EndDisabled();
 
 			ImGui::SameLine();
-			ImGui::BeginDisabled(m_analysis_current_frame >= m_processed_textures.size() - 1);
+			ImGui::BeginDisabled(m_analysis_current_frame >= m_processed_textures.Size() - 1);
 			if (ImGui::ArrowButton("##analysis_right", ImGuiDir_Right))
 				m_analysis_current_frame++;
 			ImGui::EndDisabled();
@@ -618,7 +724,7 @@ void ImageSet::DisplayImageAnalysisTab() {
 		ImGui::SeparatorText("Export");
 		if (ImGui::Button("Save Analysis CSV")) {
 			auto path = utils::SaveFileDialog(".", "Save Analysis CSV", "csv");
-			write_success = io::SaveAnalysisCsv(path.c_str(), histograms, avg_histogram, snrs, avg_snr);
+			write_success = io::SaveAnalysis(path.c_str(), histograms, avg_histogram, snrs, avg_snr);
 		}
 		if (!write_success) {
 			ImGui::TextColored(ImVec4(1, 0, 0, 1), "Error saving analysis!");
@@ -634,12 +740,12 @@ void ImageSet::DisplayImageAnalysisTab() {
 		ImGui::Separator();
 
 		// Get image dimensions and position
-		auto image_size = ImVec2(m_processed_textures[m_analysis_current_frame]->GetWidth(),
-					 m_processed_textures[m_analysis_current_frame]->GetHeight());
+		auto image_size = ImVec2(m_processed_textures.Width(m_analysis_current_frame),
+					 m_processed_textures.Height(m_analysis_current_frame));
 		ImVec2 image_pos = ImGui::GetCursorScreenPos();
 
 		// Display the image
-		ImGui::Image((ImTextureID)m_processed_textures[m_analysis_current_frame]->GetID(), image_size);
+		ImGui::Image((ImTextureID)m_processed_textures.Get(m_analysis_current_frame)->GetID(), image_size);
 
 		// Handle region selection on the image
 		if (m_region_selection_active && ImGui::IsItemHovered()) {
@@ -672,16 +778,10 @@ void ImageSet::DisplayImageAnalysisTab() {
 				int roi_width = std::max(1.0f, roi_max.x - roi_min.x);
 				int roi_height = std::max(1.0f, roi_max.y - roi_min.y);
 
-				// Get current frame data
-				uint32_t *frame_data = (uint32_t *)malloc(image_size.x * image_size.y * 4);
-				m_processed_textures[m_analysis_current_frame]->GetData(frame_data);
-
 				// Analyze the selected region
-				ImageAnalysis::AnalyzeRegion(frame_data, image_size.x, image_size.y, roi_min.x,
+				ImageAnalysis::AnalyzeRegion(m_processed.Get(m_analysis_current_frame), roi_min.x,
 							     roi_min.y, roi_width, roi_height, m_region_histogram,
 							     m_region_snr);
-
-				free(frame_data);
 			}
 		}
 
@@ -704,43 +804,29 @@ void ImageSet::DisplayImageAnalysisTab() {
 }
 
 void ImageSet::DisplayFeatureTrackingTab() {
-	static uint32_t *s_comparison_image = nullptr;
-	static uint32_t s_ref_image_width = 0, s_ref_image_height = 0;
 	if (ImGui::BeginTabItem("Feature Tracking")) {
-		if (m_processed_textures.size() == 0) {
+		if (m_processed_textures.Size() == 0) {
 			ImGui::Text("No images loaded");
 			ImGui::EndTabItem();
 			return;
 		}
 
-		if (s_comparison_image == NULL ||
-		    s_ref_image_width * s_ref_image_height !=
-			m_processed_textures[0]->GetWidth() * m_processed_textures[0]->GetHeight()) {
-			free(s_comparison_image);
-			s_comparison_image = (uint32_t *)malloc(m_processed_textures[0]->GetWidth() *
-								m_processed_textures[0]->GetHeight() * 4);
-			s_ref_image_width = m_processed_textures[0]->GetWidth();
-			s_ref_image_height = m_processed_textures[0]->GetHeight();
-		}
-
 		// Update point image if it isn't the same size as the ref
 		// texture
 		if (m_point_image == NULL ||
 		    m_point_texture.GetWidth() * m_point_texture.GetHeight() !=
-			m_processed_textures[0]->GetWidth() * m_processed_textures[0]->GetHeight()) {
+			m_processed_textures.Width(0) * m_processed_textures.Height(0)) {
 			free(m_point_image);
-			m_point_image = (uint32_t *)malloc(m_processed_textures[0]->GetWidth() *
-							   m_processed_textures[0]->GetHeight() * 4);
+			m_point_image = (uint32_t *)malloc(m_processed_textures.Width(0) *
+							   m_processed_textures.Height(0) * 4);
 		}
 
-		m_processed_textures[0]->GetData(s_comparison_image);
-		if (m_points.size() == 0 &&
-		    memcmp(m_point_image, s_comparison_image,
-			   m_processed_textures[0]->GetWidth() * m_processed_textures[0]->GetHeight() * 4) != 0) {
-			memcpy(m_point_image, s_comparison_image,
-			       m_processed_textures[0]->GetWidth() * m_processed_textures[0]->GetHeight() * 4);
-			m_point_texture.Load(s_comparison_image, m_processed_textures[0]->GetWidth(),
-					     m_processed_textures[0]->GetHeight());
+		// only rebuild the point image when the first frame changed
+		if (m_points.size() == 0 && m_point_image_version != m_processed.Version(0)) {
+			m_point_image_version = m_processed.Version(0);
+			cv::Mat point_image(m_processed.Height(), m_processed.Width(), CV_8UC4, m_point_image);
+			Frame::Convert(m_processed.Get(0).data, point_image, PixelFormat::BGRA8);
+			m_point_texture.Load(m_point_image, m_processed.Width(), m_processed.Height());
 		}
 
 		ImGui::BeginChild("Controls", ImVec2(250, 0), true);
@@ -765,22 +851,17 @@ void ImageSet::DisplayFeatureTrackingTab() {
 				m_points.clear();
 			if (m_points.size() % 2 == 0 && m_points.size() > 0) {
 				if (ImGui::Button("Track Features")) {
+					// the points are drawn into BGRA copies that replace the frames
 					std::vector<uint32_t *> frames;
-					utils::GetDataFromTextures(frames, m_processed_textures[0]->GetWidth(),
-								   m_processed_textures[0]->GetHeight(),
-								   m_processed_textures);
+					auto copies = utils::CopyFramesBGRA(m_processed, {}, frames);
 					std::vector<std::vector<cv::Point2f>> tracked_points;
 					m_manual_widths = FeatureTracker::TrackFeatures(
-					    frames, m_points, tracked_points, m_processed_textures[0]->GetWidth(),
-					    m_processed_textures[0]->GetHeight());
-					memcpy(m_point_image, frames[0],
-					       m_processed_textures[0]->GetWidth() *
-						   m_processed_textures[0]->GetHeight() * 4);
-					m_point_texture.Load(frames[0], m_processed_textures[0]->GetWidth(),
-							     m_processed_textures[0]->GetHeight());
-					utils::LoadDataIntoTexturesAndFree(m_processed_textures, frames,
-									   m_processed_textures[0]->GetWidth(),
-									   m_processed_textures[0]->GetHeight());
+					    frames, m_points, tracked_points, m_processed.Width(), m_processed.Height());
+					memcpy(m_point_image, frames[0], m_processed.Width() * m_processed.Height() * 4);
+					m_point_texture.Load(frames[0], m_processed.Width(), m_processed.Height());
+					for (int i = 0; i < copies.size(); i++)
+						m_processed.Set(i, std::move(copies[i]));
+					m_point_image_version = m_processed.Version(0);
 					m_last_points = m_points;
 					m_last_tracked_points = tracked_points;
 					m_points.clear();
@@ -790,40 +871,35 @@ void ImageSet::DisplayFeatureTrackingTab() {
 			}
 		} else {
 			if (ImGui::Button("Track Widths")) {
+				// the outlines are drawn into BGRA copies that replace the frames
 				std::vector<uint32_t *> frames;
-				utils::GetDataFromTextures(frames, m_processed_textures[0]->GetWidth(),
-							   m_processed_textures[0]->GetHeight(), m_processed_textures);
-				auto polygons = CrackDetector::DetectCracks(frames, m_processed_textures[0]->GetWidth(),
-									    m_processed_textures[0]->GetHeight());
+				auto copies = utils::CopyFramesBGRA(m_processed, {}, frames);
+				auto polygons =
+				    CrackDetector::DetectCracks(frames, m_processed.Width(), m_processed.Height());
 				m_widths = FeatureTracker::TrackCrackWidthProfiles(polygons); // Assuming m_widths is a
 											      // member variable
-				utils::LoadDataIntoTexturesAndFree(m_processed_textures, frames,
-								   m_processed_textures[0]->GetWidth(),
-								   m_processed_textures[0]->GetHeight());
+				for (int i = 0; i < copies.size(); i++)
+					m_processed.Set(i, std::move(copies[i]));
 			}
 		}
 		if (m_manual_widths.size() > 0 && manualMode) {
 			if (ImGui::Button("Clear Widths")) {
 				m_manual_widths.clear();
 				m_last_points.clear();
-				uint32_t *data =
-				    (uint32_t *)malloc(m_textures[0]->GetWidth() * m_textures[0]->GetHeight() * 4);
-				for (int i = 0; i < m_processed_textures.size(); i++) {
-					m_textures[i]->GetData(data);
-					m_processed_textures[i]->Load(data, m_processed_textures[i]->GetWidth(),
-								      m_processed_textures[i]->GetHeight());
+				for (int i = 0; i < m_processed.Size() && i < m_frames.Size(); i++) {
+					m_processed.Set(i, m_frames.Get(i));
 				}
+				// the point image is drawn on in color, so it's kept as BGRA
+				cv::Mat bgra = m_frames.Get(m_processed.Size() - 1).ToBGRA8();
 				free(m_point_image);
-				m_point_image = (uint32_t *)malloc(m_processed_textures[0]->GetWidth() *
-								   m_processed_textures[0]->GetHeight() * 4);
-				memcpy(m_point_image, data,
-				       m_processed_textures[0]->GetWidth() * m_processed_textures[0]->GetHeight() * 4);
-				m_point_texture.Load(m_point_image, m_processed_textures[0]->GetWidth(),
-						     m_processed_textures[0]->GetHeight());
+				m_point_image = (uint32_t *)malloc(bgra.total() * 4);
+				memcpy(m_point_image, bgra.data, bgra.total() * 4);
+				m_point_texture.Load(m_point_image, m_processed_textures.Width(0),
+						     m_processed_textures.Height(0));
 			}
 			if (ImGui::Button("Save To")) {
 				auto path = utils::SaveFileDialog(".", "Save Widths CSV", "csv");
-				write_success = io::WriteCSV(path.c_str(), m_widths);
+				write_success = io::WriteWidths(path.c_str(), m_widths);
 				if (!write_success) {
 					ImGui::TextColored(ImVec4(1, 0, 0, 1), "Error saving widths!");
 				}
@@ -844,7 +920,7 @@ void ImageSet::DisplayFeatureTrackingTab() {
 			}
 			if (ImGui::Button("Save To")) {
 				auto path = utils::SaveFileDialog(".", "Save Widths CSV", "csv");
-				write_success = io::WriteCSV(path.c_str(), m_widths);
+				write_success = io::WriteWidths(path.c_str(), m_widths);
 				if (!write_success) {
 					ImGui::TextColored(ImVec4(1, 0, 0, 1), "Error saving widths!");
 				}
@@ -873,14 +949,14 @@ void ImageSet::DisplayFeatureTrackingTab() {
 				int size = 3;
 				for (int i = coordX - size; i < coordX + size + 1; i++) {
 					for (int j = coordY - size; j < coordY + size + 1; j++) {
-						if (i < 0 || j < 0 || i >= m_processed_textures[0]->GetWidth() ||
-						    j >= m_processed_textures[0]->GetHeight())
+						if (i < 0 || j < 0 || i >= m_processed_textures.Width(0) ||
+						    j >= m_processed_textures.Height(0))
 							continue;
-						m_point_image[j * m_processed_textures[0]->GetWidth() + i] = 0xFFFF0000;
+						m_point_image[j * m_processed.Width() + i] = 0xFFFF0000;
 					}
 				}
-				m_point_texture.Load(m_point_image, m_processed_textures[0]->GetWidth(),
-						     m_processed_textures[0]->GetHeight());
+				m_point_texture.Load(m_point_image, m_processed_textures.Width(0),
+						     m_processed_textures.Height(0));
 			}
 		}
 		ImGui::EndChild();
@@ -897,12 +973,19 @@ void ImageSet::DisplayDeformationAnalysisTab() {
 		ImGui::BeginChild("Controls", ImVec2(250, 0), true);
 
 		// Check if processing is happening
-		bool isProcessing = DeformationAnalysisInterface::IsProcessing();
+		bool isProcessing = m_deformation_job.has_value();
 
 		if (isProcessing) {
-			ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "Processing...");
-			float progress = DeformationAnalysisInterface::GetProgress();
-			ImGui::ProgressBar(progress, ImVec2(-1, 0), "");
+			std::string stage = m_deformation_job->GetStage();
+			ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "%s... (%.1fs)",
+					   stage.empty() ? "Processing" : stage.c_str(), m_deformation_job->GetElapsed());
+			ImGui::ProgressBar(m_deformation_job->GetProgress(), ImVec2(-1, 0), "");
+
+			ImGui::BeginDisabled(m_deformation_job->IsCancelled());
+			if (ImGui::Button("Cancel", ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
+				m_deformation_job->Cancel();
+			}
+			ImGui::EndDisabled();
 		}
 
 		ImGui::SeparatorText("View Settings");
@@ -938,11 +1021,6 @@ void ImageSet::DisplayDeformationAnalysisTab() {
 		ImGui::BeginDisabled(isProcessing);
 		if (ImGui::Button("Preview Tiles")) {
 			preview_tiles_open = true;
-			// Generate preview tiles if they don't exist or if they need to be refreshed
-			if (m_preview_tile_textures.empty() && !m_processed_textures.empty()) {
-				utils::CreateTileTextures(m_preview_tile_textures, m_processed_textures[0],
-							  m_tile_config);
-			}
 		}
 		ImGui::EndDisabled();
 
@@ -955,22 +1033,27 @@ void ImageSet::DisplayDeformationAnalysisTab() {
 		}
 
 		// Use the common UI function to display the tile preview window
+		// the preview only needs the tile rects, the tiles are drawn straight
+		// from the first frame's texture
 		auto refreshTiles = [this]() {
-			if (!m_processed_textures.empty() && m_tile_need_refresh) {
-				m_preview_tile_textures.clear();
-				utils::UpdateTileTextures(m_preview_tile_textures, m_processed_textures[0],
-							  m_tile_config);
+			cv::Size size(m_processed.Width(), m_processed.Height());
+			if (m_tile_need_refresh || size != m_preview_tiles_size) {
+				m_preview_tiles = Tiler::TileRects(size, m_tile_config);
+				m_preview_tiles_size = size;
 				m_tile_need_refresh = false;
 			}
 		};
 
-		ui::DisplayTilePreviewWindow("Tiled Image Preview", preview_tiles_open, m_preview_tile_textures,
+		const Texture *preview_source = preview_tiles_open && !m_processed_textures.Empty()
+						    ? m_processed_textures.Get(0).get()
+						    : nullptr;
+		ui::DisplayTilePreviewWindow("Tiled Image Preview", preview_tiles_open, preview_source, m_preview_tiles,
 					     refreshTiles);
 
 		ImGui::Separator();
 
 		// Run Analysis button
-		ImGui::BeginDisabled(isProcessing || m_processed_textures.size() < 2);
+		ImGui::BeginDisabled(isProcessing || m_processed_textures.Size() < 2);
 
 		ImGui::SliderInt("Batch Size", &m_batch_size, 1, 32);
 		if (ImGui::IsItemHovered()) {
@@ -979,22 +1062,17 @@ void ImageSet::DisplayDeformationAnalysisTab() {
 		}
 
 		if (ImGui::Button("Run Analysis", ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
-			// gather frames
-			utils::GetDataFromTextures(m_processing_frames, m_processed_textures[0]->GetWidth(),
-						   m_processed_textures[0]->GetHeight(), m_processed_textures);
+			// gather frames, the store keeps the originals in case the run is cancelled
+			m_processing_data = utils::CopyFramesBGRA(m_processed, {}, m_processing_frames);
 
 			// Clear previous results
 			m_output_tiles.clear();
 			m_output_tile_textures.clear();
 
-			// Run the model asynchronously with the callback
-			auto future = DeformationAnalysisInterface::RunModelBatchAsync(
-			    m_processing_frames, m_processed_textures[0]->GetWidth(),
-			    m_processed_textures[0]->GetHeight(), m_output_tiles, m_tile_config, m_batch_size,
-			    [](bool b) {});
-
-			// Store the future for polling in the next frame
-			m_processing_future = std::make_shared<std::future<bool>>(std::move(future));
+			// Run the model asynchronously, the job is polled in the next frames
+			m_deformation_job = DeformationAnalysisInterface::RunModelBatchAsync(
+			    m_processing_frames, m_processed.Width(), m_processed.Height(), m_output_tiles,
+			    m_tile_config, m_batch_size, [](bool) { Application::RequestRedraw(); });
 
 			m_output_tile_textures.clear();
 		}
@@ -1,16 +1,25 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <string>
 #include <vector>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 
 #include <ui/PreprocessingTab.h>
 
+#include <OpenGL/FrameTextures.h>
 #include <OpenGL/Texture.h>
 
 #include <core/FeatureTracker.hpp>
 #include <core/DeformationAnalysisInterface.hpp>
+#include <core/FrameCache.hpp>
+#include <core/FrameStore.hpp>
+#include <core/Job.hpp>
 
 #include <imgui.h>
 
@@ -25,23 +34,52 @@ class ImageSet {
 
       private:
 	void LoadImages();
+	// moves the frames the loader finished into the stores, GL thread only
+	void AddLoadedFrames();
 	void DisplayImageComparisonTab();
 	void DisplayImageAnalysisTab();
 	void DisplayFeatureTrackingTab();
 	void DisplayDeformationAnalysisTab();
 	void DisplayTestTab();
+	void UpdateAnalysis();
 
 	static int m_id_counter;
 
 	bool m_open = true;
 	std::string m_window_name;
 	int m_window_id = 0;
+	// everything the window queues on the pool is tagged with it, so the
+	// jobs of several open image sets share the workers fairly
+	int m_session = ThreadPool::GetThreadPool().create_session();
 	std::string m_folder_path;
-	std::vector<std::shared_ptr<Texture>> m_textures;
-	std::vector<std::shared_ptr<Texture>> m_processed_textures;
+	// the loaded frames, single channel and in their original bit depth. They
+	// are views into the cache so it's declared (and destroyed) first
+	FrameCache m_frame_cache;
+	FrameStore m_frames;
+	// the processed frames start as views of the originals, frames that get
+	// color drawn into them become BGRA
+	FrameStore m_processed = FrameStore(false);
+	// display only, synced from the stores at the end of every Display
+	FrameTextures m_textures;
+	FrameTextures m_processed_textures;
+
+	// The frames are loaded in the background, the loader queues them and
+	// AddLoadedFrames adds them to the stores as they arrive
+	struct LoadQueue {
+		std::mutex mutex;
+		std::deque<Frame> frames;
+		std::atomic<int> loaded = 0;
+		std::atomic<int> total = 0;
+	};
+	std::shared_ptr<LoadQueue> m_load_queue = std::make_shared<LoadQueue>();
+	std::future<bool> m_load_future;
+	CancellationToken m_load_cancel_token;
+	bool m_loading = false;
 	uint32_t m_current_frame = 0;
 	TileConfig m_tile_config = TileConfig();
 	bool m_show_gallery_view = true; // For toggling between tile gallery and full image in deformation analysis
+	// one palette for the whole exported GIF instead of one per frame
+	bool m_gif_global_palette = false;
 
 	PreprocessingTab m_preprocessing_tab;
 
@@ -50,11 +88,21 @@ class ImageSet {
 	std::vector<cv::Point2f> m_last_points;
 	std::vector<std::vector<cv::Point2f>> m_last_tracked_points;
 	uint32_t *m_point_image = nullptr;
+	// store version of the first processed frame the point image was made from
+	uint64_t m_point_image_version = 0;
 	Texture m_point_texture;
 
 	// image analysis
-	uint32_t *m_ref_image = nullptr;
-	uint32_t m_ref_image_width = 0, m_ref_image_height = 0;
+	// results are cached by frame version so only frames that changed get
+	// re-analyzed, the averages are kept as running sums
+	struct FrameAnalysis {
+		std::vector<float> histogram;
+		float snr = 0.0f;
+	};
+	std::unordered_map<uint64_t, FrameAnalysis> m_analysis_cache;
+	std::vector<uint64_t> m_analysis_versions;
+	std::vector<double> m_histogram_sum;
+	double m_snr_sum = 0.0;
 	std::vector<std::vector<float>> histograms;
 	std::vector<float> avg_histogram;
 	std::vector<float> snrs;
@@ -78,16 +126,20 @@ class ImageSet {
 	    std::chrono::system_clock::now();
 	    
 	// deformation analysis members
-	std::vector<std::shared_ptr<Texture>> m_preview_tile_textures;
+	std::vector<cv::Rect> m_preview_tiles;
+	cv::Size m_preview_tiles_size;
 	std::vector<Tile> m_output_tiles;
 	std::vector<std::shared_ptr<Texture>> m_output_tile_textures;
 	std::shared_ptr<Texture> m_full_image_texture;
+	// the job's copies of the processed frames, m_processing_frames points
+	// into them
+	std::vector<Frame> m_processing_data;
 	std::vector<uint32_t*> m_processing_frames;
 	bool m_model_ok = true;
 	int m_batch_size = 8;
 	uint32_t m_current_tile_index = 0;
 	bool m_tile_need_refresh = false;
 	
-	// Async processing
-	std::shared_ptr<std::future<bool>> m_processing_future;
+	// the running deformation analysis, reset once its result is applied
+	std::optional<Job> m_deformation_job;
 };
@@ -1,4 +1,5 @@
 #include <ui/PreprocessingTab.h>
+#include <ui/Application.h>
 
 #include <utils.h>
 
@@ -15,10 +16,15 @@
 const char *PreprocessingTab::m_models[] = {"sfr_hrsem", "sfr_hrstem", "sfr_hrtem",
 					    "sfr_lrsem", "sfr_lrstem", "sfr_lrtem"};
 
-PreprocessingTab::PreprocessingTab(std::vector<std::shared_ptr<Texture>> &textures,
-				   std::vector<std::shared_ptr<Texture>> &processed_textures) {
-	m_textures = textures;
-	m_processed_textures = processed_textures;
+PreprocessingTab::PreprocessingTab(FrameStore &processed, FrameTextures &processed_textures)
+    : m_processed(&processed), m_processed_textures(&processed_textures) {}
+
+PreprocessingTab::~PreprocessingTab() {
+	// the job works on m_processing_frames
+	if (m_job) {
+		m_job->Cancel();
+		m_job->Wait();
+	}
 }
 
 std::vector<int> PreprocessingTab::GetFramesToProcess() const {
@@ -32,7 +38,7 @@ std::vector<int> PreprocessingTab::GetFramesToProcess() const {
 		std::sort(frames_to_process.begin(), frames_to_process.end());
 	} else {
 		// Process all frames
-		for (int i = 0; i < m_processed_textures.size(); i++) {
+		for (int i = 0; i < m_processed->Size(); i++) {
 			frames_to_process.push_back(i);
 		}
 	}
@@ -40,93 +46,78 @@ std::vector<int> PreprocessingTab::GetFramesToProcess() const {
 	return frames_to_process;
 }
 
+void PreprocessingTab::CopyFramesToProcess() {
+	m_processed_frame_indices = GetFramesToProcess();
+	m_processing_data = utils::CopyFramesBGRA(*m_processed, m_processed_frame_indices, m_processing_frames);
+}
+
 void PreprocessingTab::OnProcessingComplete(bool success) {
-	m_last_result = success;
-
-	if (success && !m_processing_frames.empty()) {
-		// Load the processed data back into specific textures
-		if (m_processed_frame_indices.size() == m_processing_frames.size() && !m_processed_frame_indices.empty()) {
-			// Load processed data back to specific frames
-			for (size_t i = 0; i < m_processing_frames.size(); i++) {
-				int frame_idx = m_processed_frame_indices[i];
-				if (frame_idx >= 0 && frame_idx < m_processed_textures.size()) {
-					m_processed_textures[frame_idx]->Load(m_processing_frames[i],
-						m_processed_textures[frame_idx]->GetWidth(),
-						m_processed_textures[frame_idx]->GetHeight());
-				}
-				free(m_processing_frames[i]);
+	// a cancelled job isn't an error, its partial results are just dropped
+	m_last_result = success || m_job->IsCancelled();
+
+	if (success) {
+		// the processed copies replace the frames, only those get uploaded
+		for (size_t i = 0; i < m_processing_data.size(); i++) {
+			int frame_idx = m_processed_frame_indices[i];
+			if (frame_idx >= 0 && frame_idx < m_processed->Size()) {
+				m_processed->Set(frame_idx, std::move(m_processing_data[i]));
 			}
-		} else {
-			// Fallback to original behavior (process all frames)
-			utils::LoadDataIntoTexturesAndFree(m_processed_textures, m_processing_frames,
-							   m_processed_textures[0]->GetWidth(),
-							   m_processed_textures[0]->GetHeight());
-		}
-	} else {
-		// Free any allocated memory in case of failure
-		for (auto frame : m_processing_frames) {
-			free(frame);
 		}
+		m_processed_textures->Sync(*m_processed);
 	}
 
+	m_processing_data.clear();
 	m_processing_frames.clear();
 	m_processed_frame_indices.clear();
+	m_job.reset();
 	m_is_processing = false;
 }
 
-void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
+void PreprocessingTab::DisplayPreprocessingTab() {
 	static TileConfig compare_config;
 	if (ImGui::BeginTabItem("Preprocessing")) {
-		if (m_processed_textures.size() == 0) {
+		if (m_processed_textures->Size() == 0) {
 			ImGui::Text("No images loaded");
 			ImGui::EndTabItem();
 			return;
 		}
 
-		// Check if any async processing has completed
-		if (m_is_processing && m_processing_future && m_processing_future->valid()) {
-			// Poll the future with zero timeout to check if it's
-			// done without blocking
-			auto status = m_processing_future->wait_for(std::chrono::seconds(0));
-			if (status == std::future_status::ready) {
-				// Get the result and update the UI
-				bool result = m_processing_future->get();
-				OnProcessingComplete(result);
-			}
+		// Check if the job has finished, without blocking
+		if (m_is_processing && m_job && m_job->IsFinished()) {
+			OnProcessingComplete(m_job->GetResult());
 		}
 
 		ImGui::BeginChild("Controls", ImVec2(250, 0));
 
 		// Processing status display
-		if (m_is_processing) {
-			ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "Processing...");
-			float progress = 0.0f;
-			if (DenoiseInterface::IsProcessing()) {
-				progress = DenoiseInterface::GetProgress();
-			} else if (Stabilizer::IsProcessing()) {
-				progress = Stabilizer::GetProgress();
-			} else if (CrackDetector::IsProcessing()) {
-				progress = CrackDetector::GetProgress();
-			}
-			ImGui::ProgressBar(progress, ImVec2(-1, 0), "");
+		if (m_is_processing && m_job) {
+			std::string stage = m_job->GetStage();
+			ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "%s... (%.1fs)",
+					   stage.empty() ? "Processing" : stage.c_str(), m_job->GetElapsed());
+			ImGui::ProgressBar(m_job->GetProgress(), ImVec2(-1, 0), "");
 			// Disable other buttons during processing
+
+			ImGui::BeginDisabled(m_job->IsCancelled());
+			if (ImGui::Button("Cancel")) {
+				m_job->Cancel();
+			}
+			ImGui::EndDisabled();
 		}
 
 		// Crop
 		ImGui::SeparatorText("Crop");
 		static int crop = 60;
-		ImGui::BeginDisabled(m_is_processing);
+		ImGui::BeginDisabled(m_is_processing || m_loading);
 		ImGui::SliderInt("Pixels", &crop, 1, 100);
-		if (ImGui::Button("Crop Bottom") && !m_is_processing) {
-			if (!(crop >= m_processed_textures[0]->GetHeight())) {
+		if (ImGui::Button("Crop Bottom") && !m_is_processing && !m_loading) {
+			if (!(crop >= m_processed->Height())) {
 				auto frames_to_process = GetFramesToProcess();
 				for (int frame_idx : frames_to_process) {
-					uint32_t *data = (uint32_t *)malloc(m_processed_textures[frame_idx]->GetWidth() *
-									    m_processed_textures[frame_idx]->GetHeight() * 4);
-					m_processed_textures[frame_idx]->GetData(data);
-					m_processed_textures[frame_idx]->Load(data, m_processed_textures[frame_idx]->GetWidth(),
-								      m_processed_textures[frame_idx]->GetHeight() - crop);
-					free(data);
+					// a view of the top rows, nothing is copied
+					const Frame &frame = m_processed->Get(frame_idx);
+					if (frame.Height() > crop)
+						m_processed->Set(frame_idx,
+								 Frame(frame.data.rowRange(0, frame.Height() - crop)));
 				}
 			}
 		}
@@ -134,7 +125,7 @@ void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
 		ImGui::SameLine();
 		ImGui::TextDisabled("(?)");
 
-		if (crop >= m_processed_textures[0]->GetHeight())
+		if (crop >= m_processed->Height())
 			ImGui::TextColored(ImVec4(1, 0, 0, 1), "Crop height too large!");
 		
 		if (ImGui::IsItemHovered())
@@ -147,30 +138,18 @@ void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
 		if (ImGui::Button("Stabilize")) {
 			m_is_processing = true;
 
-			// Get frames to process
-			auto frames_to_process = GetFramesToProcess();
-			m_processed_frame_indices = frames_to_process;
-			
-			// Copy image data for selected frames only
-			m_processing_frames.clear();
-			for (int frame_idx : frames_to_process) {
-				uint32_t* frame_data = (uint32_t*)malloc(m_processed_textures[frame_idx]->GetWidth() *
-														 m_processed_textures[frame_idx]->GetHeight() * 4);
-				utils::GetDataFromTexture(frame_data, m_processed_textures[frame_idx]);
-				m_processing_frames.push_back(frame_data);
-			}
+			// Copy the selected frames, the store keeps the originals
+			// in case the job fails or is cancelled
+			CopyFramesToProcess();
 
 			// Process asynchronously
-			auto width = m_processed_textures[0]->GetWidth();
-			auto height = m_processed_textures[0]->GetHeight();
-
-			auto future =
-			    Stabilizer::StabilizeAsync(m_processing_frames, width, height, [this](bool result) {
-				    // This callback will run in the worker
-				    // thread We don't need to do anything here
-				    // as we check the future in the main loop
-			    });
-			m_processing_future = std::make_shared<std::future<bool>>(std::move(future));
+			auto width = m_processed->Width();
+			auto height = m_processed->Height();
+
+			m_job = Stabilizer::StabilizeAsync(m_processing_frames, width, height, [](bool) {
+				// wake the main loop to check the job
+				Application::RequestRedraw();
+			});
 		}
 		ImGui::EndDisabled();
 
@@ -184,15 +163,15 @@ void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
 		}
 
 		// Create a callback for removing selected frames
-		auto removeSelectedFrames = [this, &changed]() {
-			changed = true;
+		auto removeSelectedFrames = [this]() {
 			std::vector<int> to_remove;
 			for (auto &item : m_selected_textures_map)
 				to_remove.push_back(item.first);
 			std::sort(to_remove.begin(), to_remove.end());
 			for (int i = to_remove.size() - 1; i >= 0; i--) {
-				m_processed_textures.erase(m_processed_textures.begin() + to_remove[i]);
+				m_processed->Remove(to_remove[i]);
 			}
+			m_processed_textures->Sync(*m_processed);
 			m_selected_textures_map.clear();
 		};
 
@@ -205,8 +184,16 @@ void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
 		}
 
 		// Use the common UI function to display the frame selection window
-		ui::DisplayFrameSelectionWindow("Frame Selection", choose_frames_open, m_processed_textures,
-						m_selected_textures_map, removeSelectedFrames);
+		if (choose_frames_open) {
+			m_thumbnails.Sync(*m_processed);
+			// thumbnails still being made show up over the next frames
+			if (m_thumbnails.Pending()) {
+				Application::RequestRedraw(Application::kProgressInterval);
+			}
+		}
+		ui::DisplayFrameSelectionWindow("Frame Selection", choose_frames_open, m_thumbnails,
+						m_selected_textures_map,
+						m_loading ? nullptr : std::function<void()>(removeSelectedFrames));
 		ImGui::EndDisabled();
 
 		// Denoising
@@ -221,22 +208,13 @@ void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
 		if (ImGui::Button("Blur")) {
 			m_is_processing = true;
 
-			// Get frames to process
-			auto frames_to_process = GetFramesToProcess();
-			m_processed_frame_indices = frames_to_process;
-			
-			// Copy image data for selected frames only
-			m_processing_frames.clear();
-			for (int frame_idx : frames_to_process) {
-				uint32_t* frame_data = (uint32_t*)malloc(m_processed_textures[frame_idx]->GetWidth() *
-														 m_processed_textures[frame_idx]->GetHeight() * 4);
-				utils::GetDataFromTexture(frame_data, m_processed_textures[frame_idx]);
-				m_processing_frames.push_back(frame_data);
-			}
+			// Copy the selected frames, the store keeps the originals
+			// in case the job fails or is cancelled
+			CopyFramesToProcess();
 
 			// Process asynchronously
-			auto width = m_processed_textures[0]->GetWidth();
-			auto height = m_processed_textures[0]->GetHeight();
+			auto width = m_processed->Width();
+			auto height = m_processed->Height();
 			auto kernel_size = m_kernel_size;
 			auto sigma = m_sigma;
 
@@ -244,14 +222,11 @@ void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
 			// Honestly it runs quick enough this shouldn't matter
 			// but for the sake of consistency we can use the async
 			// version
-			auto future = DenoiseInterface::BlurAsync(m_processing_frames, width, height, kernel_size,
-								  sigma, [this](bool result) {
-									  // This callback will run in the worker
-									  // thread We don't need to do anything here
-									  // as we check the future in the main loop
-								  });
-
-			m_processing_future = std::make_shared<std::future<bool>>(std::move(future));
+			m_job = DenoiseInterface::BlurAsync(m_processing_frames, width, height, kernel_size, sigma,
+							    [](bool) {
+								    // wake the main loop to check the job
+								    Application::RequestRedraw();
+							    });
 		}
 
 #ifdef UI_INCLUDE_TENSORFLOW
@@ -289,10 +264,6 @@ void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
 		static bool show_tiled_image_open = false;
 		if (ImGui::Button("Show One Tiled Image")) {
 			show_tiled_image_open = true;
-			// Ensure we have tiles to display when opening the window
-			if (m_split_textures.empty() && !m_processed_textures.empty()) {
-				utils::CreateTileTextures(m_split_textures, m_processed_textures[0], m_tile_config);
-			}
 		}
 		if (ImGui::IsItemHovered())
 			ImGui::SetTooltip("Click to show the tiled image.\nThis will split "
@@ -300,52 +271,44 @@ void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
 					  "show them in a window.\nNote: This is not the "
 					  "final result, just a preview of the tiles.");
 
-		// Create a refresh callback
+		// Create a refresh callback, only the tile rects are recomputed
 		auto refreshTiles = [this]() {
-			if (!m_processed_textures.empty() && m_tile_need_refresh) {
-				m_split_textures.clear();
-				utils::UpdateTileTextures(m_split_textures, m_processed_textures[0], m_tile_config);
+			cv::Size size(m_processed->Width(), m_processed->Height());
+			if (m_tile_need_refresh || size != m_split_tiles_size) {
+				m_split_tiles = Tiler::TileRects(size, m_tile_config);
+				m_split_tiles_size = size;
 				m_tile_need_refresh = false;
 			}
 		};
 
 		// Use the common UI function to display the tile preview window
-		ui::DisplayTilePreviewWindow("Tiled Image Preview", show_tiled_image_open, m_split_textures,
+		const Texture *split_source = show_tiled_image_open && !m_processed_textures->Empty()
+						  ? m_processed_textures->Get(0).get()
+						  : nullptr;
+		ui::DisplayTilePreviewWindow("Tiled Image Preview", show_tiled_image_open, split_source, m_split_tiles,
 					     refreshTiles);
 
 		if (ImGui::Button("Denoise")) {
 			m_is_processing = true;
 
-			// Get frames to process
-			auto frames_to_process = GetFramesToProcess();
-			m_processed_frame_indices = frames_to_process;
-			
-			// Copy image data for selected frames only
-			m_processing_frames.clear();
-			for (int frame_idx : frames_to_process) {
-				uint32_t* frame_data = (uint32_t*)malloc(m_processed_textures[frame_idx]->GetWidth() *
-														 m_processed_textures[frame_idx]->GetHeight() * 4);
-				utils::GetDataFromTexture(frame_data, m_processed_textures[frame_idx]);
-				m_processing_frames.push_back(frame_data);
-			}
+			// Copy the selected frames, the store keeps the originals
+			// in case the job fails or is cancelled
+			CopyFramesToProcess();
 
 			// Process asynchronously
-			auto width = m_processed_textures[0]->GetWidth();
-			auto height = m_processed_textures[0]->GetHeight();
+			auto width = m_processed->Width();
+			auto height = m_processed->Height();
 			auto model_name = std::string(m_models[m_selected_model]);
 			auto tile_size = m_tile_size;
 			auto center_size = m_center_size;
 			auto include_outside = m_include_outside;
 
 			// Use the async version
-			auto future = DenoiseInterface::DenoiseAsync(m_processing_frames, width, height, model_name,
-								     m_tile_config, [this](bool result) {
-									     // This callback will run in the worker
-									     // thread We don't need to do anything here
-									     // as we check the future in the main loop
-								     });
-
-			m_processing_future = std::make_shared<std::future<bool>>(std::move(future));
+			m_job = DenoiseInterface::DenoiseAsync(m_processing_frames, width, height, model_name,
+							       m_tile_config, [](bool) {
+								       // wake the main loop to check the job
+								       Application::RequestRedraw();
+							       });
 		}
 #endif
 		ImGui::EndDisabled();
@@ -373,37 +336,24 @@ void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
 		if (ImGui::Button("Detect Cracks")) {
 			m_is_processing = true;
 
-			// Get frames to process
-			auto frames_to_process = GetFramesToProcess();
-			m_processed_frame_indices = frames_to_process;
-			
-			// Copy image data for selected frames only
-			m_processing_frames.clear();
-			for (int frame_idx : frames_to_process) {
-				uint32_t* frame_data = (uint32_t*)malloc(m_processed_textures[frame_idx]->GetWidth() *
-														 m_processed_textures[frame_idx]->GetHeight() * 4);
-				utils::GetDataFromTexture(frame_data, m_processed_textures[frame_idx]);
-				m_processing_frames.push_back(frame_data);
-			}
+			// Copy the selected frames, the store keeps the originals
+			// in case the job fails or is cancelled
+			CopyFramesToProcess();
 
 			// Process asynchronously
-			auto width = m_processed_textures[0]->GetWidth();
-			auto height = m_processed_textures[0]->GetHeight();
-
-			auto future = CrackDetector::DetectCracksAsync(m_processing_frames, width, height,
-								       m_crack_darkness, // crack_darkness
-								       m_fill_threshold, // fill_threshold
-								       m_sharpness,	 // sharpness
-								       m_resolution,	 // resolution
-								       m_amount,	 // amount
-								       [this](bool result) {
-									       // This callback will run in the worker
-									       // thread We don't need to do anything
-									       // here as we check the future in the
-									       // main loop
-								       });
-
-			m_processing_future = std::make_shared<std::future<bool>>(std::move(future));
+			auto width = m_processed->Width();
+			auto height = m_processed->Height();
+
+			m_job = CrackDetector::DetectCracksAsync(m_processing_frames, width, height,
+								 m_crack_darkness, // crack_darkness
+								 m_fill_threshold, // fill_threshold
+								 m_sharpness,	   // sharpness
+								 m_resolution,	   // resolution
+								 m_amount,	   // amount
+								 [](bool) {
+									 // wake the main loop to check the job
+									 Application::RequestRedraw();
+								 });
 		}
 		ImGui::EndDisabled();
 
@@ -420,19 +370,22 @@ void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
 
 		ImGui::SameLine();
 		ImGui::BeginChild("ImageView", ImVec2(0, 0));
-		if (!m_processed_textures.empty()) {
+		if (!m_processed_textures->Empty()) {
+			// frames may have been removed
+			m_current_frame = std::min(m_current_frame, (int)m_processed_textures->Size() - 1);
+
 			// Add frame navigation controls
 			ImGui::BeginDisabled(m_is_processing);
-			if (m_processed_textures.size() > 1) {
+			if (m_processed_textures->Size() > 1) {
 				// Frame slider with text showing current/total frames
-				ImGui::Text("Frame: %d/%d", m_current_frame + 1, (int)m_processed_textures.size());
+				ImGui::Text("Frame: %d/%d", m_current_frame + 1, (int)m_processed_textures->Size());
 				ImGui::SameLine();
 				ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x - 100);
 				if (ImGui::SliderInt("##FrameSlider", &m_current_frame, 0,
-						     m_processed_textures.size() - 1, "")) {
+						     m_processed_textures->Size() - 1, "")) {
 					// Keep within bounds
 					m_current_frame = std::max(
-					    0, std::min(m_current_frame, (int)m_processed_textures.size() - 1));
+					    0, std::min(m_current_frame, (int)m_processed_textures->Size() - 1));
 				}
 
 				// Navigation buttons
@@ -443,7 +396,7 @@ void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
 				ImGui::EndDisabled();
 
 				ImGui::SameLine();
-				ImGui::BeginDisabled(m_current_frame >= m_processed_textures.size() - 1);
+				ImGui::BeginDisabled(m_current_frame >= m_processed_textures->Size() - 1);
 				if (ImGui::ArrowButton("##right", ImGuiDir_Right))
 					m_current_frame++;
 				ImGui::EndDisabled();
@@ -462,11 +415,12 @@ void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
 					float currentTime = ImGui::GetTime();
 					if (currentTime - lastTime > 0.1f) { // Advance frame every 100ms
 						m_current_frame++;
-						if (m_current_frame >= m_processed_textures.size()) {
+						if (m_current_frame >= m_processed_textures->Size()) {
 							m_current_frame = 0; // Loop back to start
 						}
 						lastTime = currentTime;
 					}
+					Application::RequestRedraw(0.1);
 				}
 			}
 			ImGui::EndDisabled();
@@ -475,9 +429,10 @@ void PreprocessingTab::DisplayPreprocessingTab(bool &changed) {
 			ImGui::Separator();
 
 			// Display the current frame
-			ImGui::Image((ImTextureID)m_processed_textures[m_current_frame]->GetID(),
-				     ImVec2(m_processed_textures[m_current_frame]->GetWidth(),
-					    m_processed_textures[m_current_frame]->GetHeight()));
+			ImGui::Image((ImTextureID)m_processed_textures->Get(m_current_frame)->GetID(),
+				     ImVec2(m_processed_textures->Width(m_current_frame),
+					    m_processed_textures->Height(m_current_frame)));
+			m_processed_textures->Prefetch(m_current_frame);
 		}
 		ImGui::EndChild();
 
@@ -1,43 +1,37 @@
 #pragma once
 
 #include <vector>
-#include <future>
 #include <memory>
+#include <optional>
 
 #include <utils.h>
 
+#include <OpenGL/FrameTextures.h>
+#include <OpenGL/FrameThumbnails.h>
 #include <OpenGL/Texture.h>
 #include <core/DenoiseInterface.hpp>
+#include <core/FrameStore.hpp>
 #include <core/Stabilizer.hpp>
 #include <core/CrackDetector.hpp>
+#include <core/Job.hpp>
 
 class PreprocessingTab {
 	public:
 		PreprocessingTab() = default;
-		PreprocessingTab(std::vector<std::shared_ptr<Texture>>& textures, std::vector<std::shared_ptr<Texture>>& processed_textures);
-		// don't let this free the textures/texture vectors, they are allocated and freed in ImageSet
-		~PreprocessingTab() {}
-		void DisplayPreprocessingTab(bool& changed);
-		void GetProcessedTextures(std::vector<std::shared_ptr<Texture>>& processed_textures) { processed_textures = m_processed_textures; }
-		void SetProcessedTextures(std::vector<std::shared_ptr<Texture>>& processed_textures) { m_processed_textures = processed_textures; }
+		// the frames and their textures are owned by ImageSet, the tab works
+		// on the frames and the textures are only drawn
+		PreprocessingTab(FrameStore& processed, FrameTextures& processed_textures);
+		~PreprocessingTab();
+		void DisplayPreprocessingTab();
 
 		// Check if processing is currently happening
 		bool IsProcessing() const { return m_is_processing; }
+		// while the image set is still adding frames nothing may crop or
+		// remove processed frames, they have to line up with the originals
+		void SetLoading(bool loading) { m_loading = loading; }
 
 		// Get the current progress (0.0 to 1.0)
-		float GetProgress() const {
-			// Processing status display
-			float progress = 0.0f;
-			if (DenoiseInterface::IsProcessing()) {
-				progress = DenoiseInterface::GetProgress();
-			} else if (Stabilizer::IsProcessing()) {
-				progress = Stabilizer::GetProgress();
-			}
-			else if (CrackDetector::IsProcessing()) {
-				progress = CrackDetector::GetProgress();
-			}
-			return progress;
-		}
+		float GetProgress() const { return m_job ? m_job->GetProgress() : 0.0f; }
 
 	private:
 		// Helper methods to update UI after async processing completes
@@ -48,14 +42,18 @@ class PreprocessingTab {
 		
 		// Helper method to get frames to process based on selection
 		std::vector<int> GetFramesToProcess() const;
+		// copies the frames to process into m_processing_data for a job
+		void CopyFramesToProcess();
 
-		// Our textures
-		std::vector<std::shared_ptr<Texture>> m_textures;
-		std::vector<std::shared_ptr<Texture>> m_processed_textures;
+		FrameStore* m_processed = nullptr;
+		FrameTextures* m_processed_textures = nullptr;
+		// for the frame selection window, only synced while it's open
+		FrameThumbnails m_thumbnails;
 		std::map<int, int> m_selected_textures_map;
 
 		// for splitting tiles and denoising
-		std::vector<std::shared_ptr<Texture>> m_split_textures;
+		std::vector<cv::Rect> m_split_tiles;
+		cv::Size m_split_tiles_size;
 		int m_tile_size = 256; 
 		int m_center_size = 64;
 		int m_overlap = 0;
@@ -66,10 +64,15 @@ class PreprocessingTab {
 		static const char* m_models[];
 		int m_selected_model = 0;
 
+		// the job's copies of the frames, put back into the store when it
+		// succeeds. m_processing_frames points into them
+		std::vector<Frame> m_processing_data;
 		std::vector<uint32_t*> m_processing_frames;
-		std::shared_ptr<std::future<bool>> m_processing_future;
+		// the running job, reset once its result is applied
+		std::optional<Job> m_job;
 		bool m_is_processing = false;
 		bool m_last_result = true;
+		bool m_loading = false;
 
 		int m_kernel_size = 3;
 		float m_sigma = 1.0f;
@@ -1,6 +1,10 @@
 #include <utils.h>
 
-#include <fstream>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
 #include <stdio.h>
 #include <string.h>
 
@@ -10,11 +14,16 @@
 
 #include <imgui.h>
 
+#include <core/ThreadPool.hpp>
+
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN // i love this
 #define NOMINMAX	    // i hate this
 #include <shobjidl.h>
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 namespace utils {
@@ -27,7 +36,7 @@ std::string OpenFileDialog(const char *open_path, const char *title, const bool
 	if (SUCCEEDED(CoCreateInstance(CLSID_FileOpenDialog, nullptr, CLSCTX_ALL, IID_IFileDialog,
 				       reinterpret_cast<void **>(&pFileDialog)))) {
 		DWORD dwOptions;
-		if (SUCCEEDED(pFileDialog->GetOptions(&dwOptions))) {
+		if (folders_only && SUCCEEDED(pFileDialog->GetOptions(&dwOptions))) {
 			pFileDialog->SetOptions(dwOptions | FOS_PICKFOLDERS);
 		}
 
@@ -130,96 +139,48 @@ std::string SaveFileDialog(const char *save_path, const char *title, const char
 #endif
 }
 
-void GetDataFromTexture(unsigned int *data, std::shared_ptr<Texture> texture, int width, int height) {
-	if (width == 0 || height == 0) {
-		width = texture->GetWidth();
-		height = texture->GetHeight();
-	}
-	if (data == NULL)
-		data = (uint32_t *)malloc(width * height * 4);
-	texture->GetData(data);
-}
-
-void GetDataFromTextures(std::vector<uint32_t *> &data, int width, int height,
-			 std::vector<std::shared_ptr<Texture>> &textures) {
+std::vector<Frame> CopyFramesBGRA(const FrameStore &store, const std::vector<int> &indices,
+				  std::vector<uint32_t *> &pixels) {
 	PROFILE_FUNCTION();
 
-	if (data.size() != textures.size())
-		data.resize(textures.size());
-	for (int i = 0; i < textures.size(); i++) {
-		if (data[i] == nullptr)
-			data[i] = (uint32_t *)malloc(width * height * 4);
-		textures[i]->GetData(data[i]);
+	std::vector<int> all;
+	if (indices.empty()) {
+		for (int i = 0; i < store.Size(); i++)
+			all.push_back(i);
 	}
-}
-
-void LoadDataIntoTexturesAndFree(std::vector<std::shared_ptr<Texture>> &textures, std::vector<uint32_t *> &data,
-				 int width, int height) {
-	PROFILE_FUNCTION();
-
-	for (int i = 0; i < textures.size(); i++) {
-		textures[i]->Load(data[i], width, height);
-		free(data[i]);
+	const std::vector<int> &copied = indices.empty() ? all : indices;
+
+	std::vector<Frame> frames(copied.size());
+	pixels.resize(copied.size());
+	for (int i = 0; i < copied.size(); i++) {
+		// the modules take the pixels as packed rows
+		frames[i] = Frame(store.Get(copied[i]).Width(), store.Get(copied[i]).Height(), PixelFormat::BGRA8);
+		Frame::Convert(store.Get(copied[i]).data, frames[i].data, PixelFormat::BGRA8);
+		pixels[i] = (uint32_t *)frames[i].data.data;
 	}
+	return frames;
 }
 
-void CreateTileTextures(std::vector<std::shared_ptr<Texture>> &tile_textures,
-			const std::shared_ptr<Texture> &source_texture, const TileConfig &tile_config) {
+cv::Mat MakeThumbnail(const Frame &frame, int max_size) {
 	PROFILE_FUNCTION();
 
-	// Clear any existing textures
-	tile_textures.clear();
-
-	// Get the image data from the source texture
-	uint32_t *data = new uint32_t[source_texture->GetWidth() * source_texture->GetHeight()];
-	source_texture->GetData(data);
-
-	// Convert to OpenCV format
-	cv::Mat img = cv::Mat(source_texture->GetHeight(), source_texture->GetWidth(), CV_8UC4, data);
-
-	// Create tiles
-	auto tiles = Tiler::CreateTiles(img, tile_config);
-
-	// Create textures from tiles
-	for (auto &tile : tiles) {
-		auto texture = std::make_shared<Texture>();
-		texture->Load((uint32_t *)tile.data.data, tile.data.cols, tile.data.rows);
-		tile_textures.push_back(texture);
+	cv::Mat image = frame.data;
+	while (std::max(image.cols, image.rows) > max_size * 2) {
+		cv::Mat half;
+		cv::pyrDown(image, half);
+		image = half;
 	}
-
-	// Clean up
-	delete[] data;
-}
-
-void UpdateTileTextures(std::vector<std::shared_ptr<Texture>> &tile_textures,
-			const std::shared_ptr<Texture> &source_texture, const TileConfig &tile_config) {
-	PROFILE_FUNCTION();
-
-	// Get the image data from the source texture
-	uint32_t *data = new uint32_t[source_texture->GetWidth() * source_texture->GetHeight()];
-	source_texture->GetData(data);
-
-	// Convert to OpenCV format
-	cv::Mat img = cv::Mat(source_texture->GetHeight(), source_texture->GetWidth(), CV_8UC4, data);
-
-	// Create tiles
-	auto tiles = Tiler::CreateTiles(img, tile_config);
-
-	if (tile_textures.size() != tiles.size()) {
-		tile_textures.clear();
-		for (auto &tile : tiles) {
-			auto texture = std::make_shared<Texture>();
-			texture->Load((uint32_t *)tile.data.data, tile.data.cols, tile.data.rows);
-			tile_textures.push_back(texture);
-		}
-	} else {
-		for (int i = 0; i < tile_textures.size(); i++) {
-			tile_textures[i]->Load((uint32_t *)tiles[i].data.data, tiles[i].data.cols, tiles[i].data.rows);
-		}
+	double scale = (double)max_size / std::max(image.cols, image.rows);
+	if (scale < 1.0) {
+		cv::Mat resized;
+		cv::resize(image, resized,
+			   cv::Size(std::max(1, (int)(image.cols * scale)), std::max(1, (int)(image.rows * scale))), 0,
+			   0, cv::INTER_AREA);
+		image = resized;
 	}
-
-	// Clean up
-	delete[] data;
+	cv::Mat bgra = Frame(image).ToBGRA8();
+	// still a view of the frame if it was a small BGRA one to begin with
+	return bgra.data == frame.data.data ? bgra.clone() : bgra;
 }
 
 bool DirectoryContainsTiff(const std::filesystem::path &path) {
@@ -229,14 +190,18 @@ bool DirectoryContainsTiff(const std::filesystem::path &path) {
 	return false;
 }
 
+bool IsTiffFile(const std::filesystem::path &path) {
+	return std::filesystem::is_regular_file(path) && path.extension().string().find(".tif") == 0;
+}
+
 } // namespace utils
 
 // UI helper functions implementation
 namespace ui {
 
-void DisplayTilePreviewWindow(const char *window_title, bool &is_open,
-			      std::vector<std::shared_ptr<Texture>> &tile_textures,
-			      std::function<void()> refresh_callback, int tile_size, int columns) {
+void DisplayTilePreviewWindow(const char *window_title, bool &is_open, const Texture *source,
+			      const std::vector<cv::Rect> &tiles, std::function<void()> refresh_callback, int tile_size,
+			      int columns) {
 
 	if (!is_open) {
 		return;
@@ -248,29 +213,58 @@ void DisplayTilePreviewWindow(const char *window_title, bool &is_open,
 	// Create a regular window with a close button
 	if (ImGui::Begin(window_title, &is_open,
 			 ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoDocking)) {
-		// Count of tiles
-		ImGui::Text("Tiles: %d", (int)tile_textures.size());
-
 		// Refresh if callback provided
 		if (refresh_callback) {
 			refresh_callback();
 		}
 
-		ImGui::Separator();
-
-		// Display tiles in a grid
-		for (int i = 0; i < tile_textures.size(); i++) {
-			// Start a new row after 'columns' tiles
-			if (i % columns != 0 && i > 0) {
-				ImGui::SameLine();
-			}
+		// Count of tiles
+		ImGui::Text("Tiles: %d", (int)tiles.size());
 
-			// Display the tile
-			ImGui::Image(tile_textures[i]->GetID(), ImVec2((float)tile_size, (float)tile_size));
+		ImGui::Separator();
 
-			// Show tooltip on hover
-			if (ImGui::IsItemHovered()) {
-				ImGui::SetTooltip("Tile %d", i);
+		// Display tiles in a grid, only the rows that are scrolled into view.
+		// Every tile is a part of the source texture, nothing is copied
+		int count = source ? (int)tiles.size() : 0;
+		float width = source ? (float)source->GetWidth() : 1.0f;
+		float height = source ? (float)source->GetHeight() : 1.0f;
+		cv::Rect bounds(0, 0, (int)width, (int)height);
+		ImDrawList *draw_list = ImGui::GetWindowDrawList();
+		ImGuiListClipper clipper;
+		clipper.Begin((count + columns - 1) / columns);
+		while (clipper.Step()) {
+			for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+				for (int i = row * columns; i < std::min(count, (row + 1) * columns); i++) {
+					// Start a new row after 'columns' tiles
+					if (i % columns != 0) {
+						ImGui::SameLine();
+					}
+
+					// Display the tile, the part past the image's edge is
+					// black like the tiler's padding
+					ImVec2 pos = ImGui::GetCursorScreenPos();
+					ImGui::Dummy(ImVec2((float)tile_size, (float)tile_size));
+					draw_list->AddRectFilled(pos, ImVec2(pos.x + tile_size, pos.y + tile_size),
+								 IM_COL32(0, 0, 0, 255));
+
+					const cv::Rect &tile = tiles[i];
+					cv::Rect visible = tile & bounds;
+					if (!visible.empty()) {
+						float scale = (float)tile_size / tile.width;
+						ImVec2 p0(pos.x + (visible.x - tile.x) * scale,
+							  pos.y + (visible.y - tile.y) * scale);
+						ImVec2 p1(p0.x + visible.width * scale, p0.y + visible.height * scale);
+						draw_list->AddImage((ImTextureID)source->GetID(), p0, p1,
+								    ImVec2(visible.x / width, visible.y / height),
+								    ImVec2((visible.x + visible.width) / width,
+									   (visible.y + visible.height) / height));
+					}
+
+					// Show tooltip on hover
+					if (ImGui::IsItemHovered()) {
+						ImGui::SetTooltip("Tile %d", i);
+					}
+				}
 			}
 		}
 
@@ -280,7 +274,7 @@ void DisplayTilePreviewWindow(const char *window_title, bool &is_open,
 }
 
 void DisplayFrameSelectionWindow(const char *window_title, bool &is_open,
-				 std::vector<std::shared_ptr<Texture>> &textures, std::map<int, int> &selected_map,
+				 const FrameThumbnails &thumbnails, std::map<int, int> &selected_map,
 				 std::function<void()> on_remove_callback, int frame_size, int columns) {
 
 	if (!is_open) {
@@ -298,7 +292,7 @@ void DisplayFrameSelectionWindow(const char *window_title, bool &is_open,
 
 		// Action buttons
 		if (ImGui::Button("Select All")) {
-			for (int i = 0; i < textures.size(); i++)
+			for (int i = 0; i < thumbnails.Size(); i++)
 				selected_map[i] = 1;
 		}
 		ImGui::SameLine();
@@ -306,118 +300,363 @@ void DisplayFrameSelectionWindow(const char *window_title, bool &is_open,
 		if (ImGui::Button("Deselect All"))
 			selected_map.clear();
 
+		ImGui::BeginDisabled(!on_remove_callback);
 		if (ImGui::Button("Remove Selected")) {
 			// Call the provided callback to handle removal
 			if (on_remove_callback) {
 				on_remove_callback();
 			}
 		}
+		ImGui::EndDisabled();
 
 		ImGui::SeparatorText("Frames");
 
-		// Display frames in a grid
-		for (int i = 0; i < textures.size(); i++) {
-			char name[100];
-			sprintf(name, "Image %d", i);
-
-			bool selected = selected_map.find(i) != selected_map.end();
-
-			// Highlight selected frames
-			if (selected) {
-				ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(1, 0.2, 0.2, 1));
+		// Display frames in a grid. Only the rows that are scrolled into view
+		// are submitted, so a long sequence costs no more than a short one
+		int count = (int)thumbnails.Size();
+		ImGuiListClipper clipper;
+		clipper.Begin((count + columns - 1) / columns);
+		while (clipper.Step()) {
+			for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+				for (int i = row * columns; i < std::min(count, (row + 1) * columns); i++) {
+					bool selected = selected_map.find(i) != selected_map.end();
+
+					// Start a new row after 'columns' frames
+					if (i % columns != 0) {
+						ImGui::SameLine();
+					}
+
+					// Highlight selected frames
+					if (selected) {
+						ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(1, 0.2, 0.2, 1));
+					}
+
+					const auto &thumbnail = thumbnails.Get(i);
+					ImGui::PushID(i);
+					if (thumbnail.texture) {
+						ImGui::ImageButton("Image", (ImTextureID)thumbnail.texture,
+								   ImVec2((float)frame_size, (float)frame_size),
+								   ImVec2(thumbnail.u0, thumbnail.v0),
+								   ImVec2(thumbnail.u1, thumbnail.v1));
+					} else {
+						// the thumbnail is still being made, same size as the image buttons
+						ImVec2 padding = ImGui::GetStyle().FramePadding;
+						ImGui::Button("...", ImVec2(frame_size + padding.x * 2, frame_size + padding.y * 2));
+					}
+					ImGui::PopID();
+
+					if (selected) {
+						ImGui::PopStyleColor();
+					}
+
+					// Show tooltip on hover
+					if (ImGui::IsItemHovered()) {
+						ImGui::SetTooltip("Frame %d", i);
+					}
+
+					// Toggle selection on click
+					if (ImGui::IsItemClicked()) {
+						if (selected)
+							selected_map.erase(i);
+						else
+							selected_map[i] = 1;
+					}
+				}
 			}
+		}
 
-			ImGui::ImageButton(name, (ImTextureID)textures[i]->GetID(),
-					   ImVec2((float)frame_size, (float)frame_size));
+		ImGui::Separator();
+	}
+	ImGui::End();
+}
 
-			if (selected) {
-				ImGui::PopStyleColor();
-			}
+} // namespace ui
 
-			// Start a new row after 'columns' frames
-			if (i % columns != columns - 1 && i < textures.size() - 1) {
-				ImGui::SameLine();
+namespace io {
+// Converts `count` pixels of a decoded strip/tile row to the RGBA layout
+// TIFFRGBAImageGet produces (R, G, B, A bytes, opaque alpha). 16 bit samples
+// are reduced to 8 bit the same way libtiff does.
+static void ConvertTiffRow(const uint8_t *src, uint8_t *dst, int count, uint16_t bits, uint16_t samples,
+			   uint16_t photometric) {
+	if (photometric == PHOTOMETRIC_RGB) {
+		for (int x = 0; x < count; x++) {
+			for (int c = 0; c < 3; c++) {
+				dst[c] = bits == 8 ? src[c] : (uint8_t)((((const uint16_t *)src)[c] + 128) / 257);
 			}
+			dst[3] = 255;
+			src += samples * bits / 8;
+			dst += 4;
+		}
+		return;
+	}
 
-			// Show tooltip on hover
-			if (ImGui::IsItemHovered()) {
-				ImGui::SetTooltip("Frame %d", i);
-			}
+	bool invert = photometric == PHOTOMETRIC_MINISWHITE;
+	for (int x = 0; x < count; x++) {
+		uint8_t v = bits == 8 ? src[0] : (uint8_t)(((const uint16_t *)src)[0] >> 8);
+		if (invert)
+			v = 255 - v;
+		dst[0] = dst[1] = dst[2] = v;
+		dst[3] = 255;
+		src += samples * bits / 8;
+		dst += 4;
+	}
+}
 
-			// Toggle selection on click
-			if (ImGui::IsItemClicked()) {
-				if (selected)
-					selected_map.erase(i);
-				else
-					selected_map[i] = 1;
+struct TiffLayout {
+	uint16_t bits = 1;
+	uint16_t samples = 1;
+	uint16_t photometric = 0;
+	uint16_t planar = PLANARCONFIG_CONTIG;
+	uint16_t orientation = ORIENTATION_TOPLEFT;
+	uint16_t sample_format = SAMPLEFORMAT_UINT;
+};
+
+// false if the photometric interpretation is missing
+static bool GetTiffLayout(TIFF *tif, TiffLayout &layout) {
+	TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &layout.bits);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &layout.samples);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &layout.planar);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_ORIENTATION, &layout.orientation);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLEFORMAT, &layout.sample_format);
+	return TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &layout.photometric);
+}
+
+// Decodes every strip or tile of an interleaved, top-left image and passes
+// each decoded row segment to `row` with its image coordinates and length
+static bool ForEachTiffRow(TIFF *tif, int width, int height, size_t pixel_size,
+			   const std::function<void(int y, int x, const uint8_t *src, int count)> &row) {
+	if (TIFFIsTiled(tif)) {
+		uint32_t tile_width = 0, tile_height = 0;
+		TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tile_width);
+		TIFFGetField(tif, TIFFTAG_TILELENGTH, &tile_height);
+		if (tile_width == 0 || tile_height == 0)
+			return false;
+
+		std::vector<uint8_t> buffer(TIFFTileSize(tif));
+		for (uint32_t ty = 0; ty < (uint32_t)height; ty += tile_height) {
+			for (uint32_t tx = 0; tx < (uint32_t)width; tx += tile_width) {
+				if (TIFFReadTile(tif, buffer.data(), tx, ty, 0, 0) < 0)
+					return false;
+				// edge tiles are padded to the full tile size
+				int rows = std::min<int>(tile_height, height - ty);
+				int cols = std::min<int>(tile_width, width - tx);
+				for (int y = 0; y < rows; y++) {
+					row(ty + y, tx, buffer.data() + y * tile_width * pixel_size, cols);
+				}
 			}
 		}
+		return true;
+	}
 
-		ImGui::Separator();
+	uint32_t rows_per_strip = height;
+	TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+	rows_per_strip = std::min<uint32_t>(rows_per_strip, height);
+	if (rows_per_strip == 0)
+		return false;
+
+	size_t row_size = (size_t)width * pixel_size;
+	std::vector<uint8_t> buffer(TIFFStripSize(tif));
+	for (uint32_t strip = 0; strip < TIFFNumberOfStrips(tif); strip++) {
+		uint32_t first_row = strip * rows_per_strip;
+		if (first_row >= (uint32_t)height)
+			break;
+		if (TIFFReadEncodedStrip(tif, strip, buffer.data(), buffer.size()) < 0)
+			return false;
+		int rows = std::min<int>(rows_per_strip, height - first_row);
+		for (int y = 0; y < rows; y++) {
+			row(first_row + y, 0, buffer.data() + y * row_size, width);
+		}
 	}
-	ImGui::End();
+	return true;
 }
 
-} // namespace ui
+// Fast path for the common microscope formats (8/16 bit gray or RGB, top-left
+// origin, interleaved samples). Reads the strips/tiles straight into the
+// output so there's no intermediate raster and no flip. Returns false if the
+// file needs the generic RGBA path.
+static bool ReadTiffDirect(TIFF *tif, int width, int height, uint32_t *raster) {
+	TiffLayout layout;
+	if (!GetTiffLayout(tif, layout))
+		return false;
 
-namespace io {
-unsigned int *LoadTiff(const char *path, int &width, int &height) {
-	PROFILE_FUNCTION();
+	// extra (alpha) samples are left to libtiff, it knows how to apply them
+	bool gray = (layout.photometric == PHOTOMETRIC_MINISBLACK || layout.photometric == PHOTOMETRIC_MINISWHITE) &&
+		    layout.samples == 1;
+	bool rgb = layout.photometric == PHOTOMETRIC_RGB && layout.samples == 3;
+	if ((!gray && !rgb) || (layout.bits != 8 && layout.bits != 16) || layout.planar != PLANARCONFIG_CONTIG ||
+	    layout.orientation != ORIENTATION_TOPLEFT || layout.sample_format != SAMPLEFORMAT_UINT)
+		return false;
+
+	uint8_t *out = (uint8_t *)raster;
+	return ForEachTiffRow(tif, width, height, layout.samples * layout.bits / 8,
+			      [&](int y, int x, const uint8_t *src, int count) {
+				      ConvertTiffRow(src, out + ((size_t)y * width + x) * 4, count, layout.bits,
+						     layout.samples, layout.photometric);
+			      });
+}
+
+// Reads single channel 8/16 bit and float images without any conversion,
+// returns false for anything else
+static bool ReadTiffNative(TIFF *tif, int width, int height, Frame &frame) {
+	TiffLayout layout;
+	if (!GetTiffLayout(tif, layout))
+		return false;
+
+	bool is_uint = layout.sample_format == SAMPLEFORMAT_UINT && (layout.bits == 8 || layout.bits == 16);
+	bool is_float = layout.sample_format == SAMPLEFORMAT_IEEEFP && layout.bits == 32 &&
+			layout.photometric == PHOTOMETRIC_MINISBLACK;
+	if ((layout.photometric != PHOTOMETRIC_MINISBLACK && layout.photometric != PHOTOMETRIC_MINISWHITE) ||
+	    layout.samples != 1 || (!is_uint && !is_float) || layout.planar != PLANARCONFIG_CONTIG ||
+	    layout.orientation != ORIENTATION_TOPLEFT)
+		return false;
+
+	PixelFormat format = is_float ? PixelFormat::Gray32F
+				      : (layout.bits == 8 ? PixelFormat::Gray8 : PixelFormat::Gray16);
+	Frame out(width, height, format);
+	size_t pixel_size = out.data.elemSize();
+	bool ok = ForEachTiffRow(tif, width, height, pixel_size, [&](int y, int x, const uint8_t *src, int count) {
+		memcpy(out.data.ptr(y) + x * pixel_size, src, count * pixel_size);
+	});
+	if (!ok)
+		return false;
 
-	// set the warning handler to null to avoid printing warnings
-	// errors are still printed
-	TIFFSetWarningHandler(nullptr);
+	if (layout.photometric == PHOTOMETRIC_MINISWHITE) {
+		cv::bitwise_not(out.data, out.data);
+	}
+	frame = out;
+	return true;
+}
+
+// Opens a tiff for reading. Warnings are turned off (errors are still
+// printed), only once since files are decoded concurrently.
+static TIFF *OpenTiff(const char *path) {
+	static bool warnings_disabled = (TIFFSetWarningHandler(nullptr), true);
+	(void)warnings_disabled;
 	TIFF *tif = TIFFOpen(path, "r");
 	if (!tif) {
 		printf("Could not open file %s\n", path);
-		return NULL;
 	}
-	size_t npixels;
-	uint32_t *raster;
-	size_t samplesperpixel;
+	return tif;
+}
 
+// Decodes the current directory of `tif` to BGRA, NULL on failure
+static uint32_t *ReadTiffRGBA(TIFF *tif, const char *path, int &width, int &height) {
 	TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
 	TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
-	TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &samplesperpixel);
 
+	size_t npixels = (size_t)width * height;
+	uint32_t *raster = (uint32_t *)_TIFFmalloc(npixels * sizeof(uint32_t));
+	if (!raster) {
+		return NULL;
+	}
+
+	{
+		PROFILE_SCOPE(LoadTiffDirect);
+		if (ReadTiffDirect(tif, width, height, raster)) {
+			return raster;
+		}
+	}
+
+	// anything else (palette, YCbCr, planar, bottom-up, ...) goes through
+	// libtiff's generic RGBA conversion, asking for a top-down raster so
+	// it doesn't have to be flipped afterwards
 	TIFFRGBAImage img;
 	char emsg[1024];
 	if (!TIFFRGBAImageBegin(&img, tif, 0, emsg)) {
 		TIFFError(path, "%s", emsg);
-		TIFFClose(tif);
+		_TIFFfree(raster);
 		return NULL;
 	}
-	npixels = width * height;
-	raster = (uint32_t *)_TIFFmalloc(npixels * sizeof(uint32_t));
-	if (raster) {
-		if (TIFFRGBAImageGet(&img, raster, width, height)) {
-			// flip the image
-			uint32_t *temp = (uint32_t *)_TIFFmalloc(npixels * sizeof(uint32_t));
-			for (int i = 0; i < height; i++) {
-				memcpy(temp + i * width, raster + (height - i - 1) * width, width * sizeof(uint32_t));
-			}
-			TIFFRGBAImageEnd(&img);
-			_TIFFfree(raster);
-			TIFFClose(tif);
-			return temp;
-		}
-	}
+	img.req_orientation = ORIENTATION_TOPLEFT;
+	bool ok = TIFFRGBAImageGet(&img, raster, width, height);
 	TIFFRGBAImageEnd(&img);
-	_TIFFfree(raster);
+	if (!ok) {
+		_TIFFfree(raster);
+		return NULL;
+	}
+	return raster;
+}
+
+// Decodes the current directory of `tif`, natively if it's single channel
+static bool ReadTiffFrame(TIFF *tif, const char *path, Frame &frame) {
+	int width = 0, height = 0;
+	TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
+	TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
+	if (ReadTiffNative(tif, width, height, frame)) {
+		return true;
+	}
+
+	// color or otherwise unusual files end up as BGRA like in the texture path
+	uint32_t *pixels = ReadTiffRGBA(tif, path, width, height);
+	if (!pixels) {
+		return false;
+	}
+	frame = Frame::WrapBGRA(pixels, width, height).Clone();
+	_TIFFfree(pixels);
+	return true;
+}
+
+unsigned int *LoadTiff(const char *path, int &width, int &height) {
+	PROFILE_FUNCTION();
+
+	TIFF *tif = OpenTiff(path);
+	if (!tif) {
+		return NULL;
+	}
+	uint32_t *raster = ReadTiffRGBA(tif, path, width, height);
+	TIFFClose(tif);
+	return raster;
+}
+
+bool LoadTiff(const char *path, Frame &frame) {
+	PROFILE_FUNCTION();
+
+	TIFF *tif = OpenTiff(path);
+	if (!tif) {
+		return false;
+	}
+	bool ok = ReadTiffFrame(tif, path, frame);
 	TIFFClose(tif);
-	return NULL;
+	return ok;
 }
 
-bool LoadTiffFolder(const char *folder_path, std::vector<uint32_t *> &images, int &width, int &height) {
+int GetTiffPageCount(const char *path) {
+	TIFF *tif = OpenTiff(path);
+	if (!tif) {
+		return -1;
+	}
+	int count = TIFFNumberOfDirectories(tif);
+	TIFFClose(tif);
+	return count;
+}
+
+bool LoadTiffPage(const char *path, int page, Frame &frame) {
 	PROFILE_FUNCTION();
 
+	TIFF *tif = OpenTiff(path);
+	if (!tif) {
+		return false;
+	}
+	bool ok = TIFFSetDirectory(tif, (tdir_t)page) && ReadTiffFrame(tif, path, frame);
+	if (!ok) {
+		printf("Could not read page %d of %s\n", page, path);
+	}
+	TIFFClose(tif);
+	return ok;
+}
+
+// sorted paths of all the tiffs in a folder, or just the file itself for a stack
+static bool ListTiffFiles(const char *folder_path, std::vector<std::string> &files) {
 	if (!std::filesystem::exists(folder_path)) {
 		printf("Path does not exist\n");
 		return false;
 	}
+	if (std::filesystem::is_regular_file(folder_path)) {
+		files.push_back(folder_path);
+		return true;
+	}
 
 	// find all .tif files in the folder
-	std::vector<std::string> files;
 	for (const auto &entry : std::filesystem::directory_iterator(folder_path)) {
 		if (entry.path().string().find(".tif") == std::string::npos)
 			continue;
@@ -426,21 +665,435 @@ bool LoadTiffFolder(const char *folder_path, std::vector<uint32_t *> &images, in
 
 	// sort the files by name
 	std::sort(files.begin(), files.end());
-	for (const auto &file : files) {
-		PROFILE_SCOPE(LoadTiffFolderLoop);
+	return true;
+}
 
-		uint32_t *temp = io::LoadTiff(file.c_str(), width, height);
-		if (!temp) {
-			printf("Could not load file %s\n", file.c_str());
-			return false;
+// Decodes `count` frames concurrently on the thread pool with `decode` and
+// passes them to on_frame on the calling thread in order. `name` describes a
+// frame in error messages.
+static bool StreamDecodedFrames(size_t count, const std::function<bool(size_t index, Frame &frame)> &decode,
+				const std::function<std::string(size_t index)> &name,
+				const std::function<void(int index, Frame frame)> &on_frame,
+				const std::function<void(int loaded, int total)> &on_progress,
+				const CancellationToken &token) {
+	struct DecodedFrame {
+		Frame frame;
+		bool ok = false;
+		bool done = false;
+	};
+
+	auto &pool = ThreadPool::GetThreadPool();
+	std::vector<DecodedFrame> decoded(count);
+	std::mutex mutex;
+	std::atomic<bool> stop = false;
+
+	// only a window of frames ahead of the next delivered one is decoded so a
+	// slow consumer doesn't end up with the whole sequence in memory twice.
+	// Declared after everything the tasks touch so it waits for them first.
+	TaskGroup group(pool, TaskPriority::Normal);
+	const size_t window = pool.get_thread_count() * 2;
+	size_t submitted = 0;
+	auto prefetch = [&](size_t delivered) {
+		while (submitted < count && submitted < delivered + window) {
+			size_t i = submitted++;
+			group.run([&, i]() {
+				PROFILE_SCOPE(LoadTiffFolderDecode);
+
+				DecodedFrame result;
+				if (!stop) {
+					result.ok = decode(i, result.frame);
+				}
+				result.done = true;
+
+				std::unique_lock<std::mutex> lock(mutex);
+				decoded[i] = std::move(result);
+			});
+		}
+	};
+
+	int width = 0, height = 0;
+	bool success = true;
+	for (size_t next = 0; next < count; ++next) {
+		if (token.is_cancelled()) {
+			success = false;
+			break;
+		}
+		prefetch(next);
+
+		// a worker helps decoding instead of just blocking
+		group.wait_until([&]() {
+			std::unique_lock<std::mutex> lock(mutex);
+			return decoded[next].done;
+		});
+		DecodedFrame result;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			result = std::move(decoded[next]);
+		}
+
+		if (!result.ok) {
+			printf("Could not load %s\n", name(next).c_str());
+			success = false;
+			break;
+		}
+		if (next == 0) {
+			width = result.frame.Width();
+			height = result.frame.Height();
+		} else if (result.frame.Width() != width || result.frame.Height() != height) {
+			printf("Image size of %s doesn't match the first image\n", name(next).c_str());
+			success = false;
+			break;
+		}
+
+		on_frame((int)next, std::move(result.frame));
+		if (on_progress) {
+			on_progress((int)next + 1, (int)count);
+		}
+	}
+
+	if (!success) {
+		// let the queued decodes finish without doing anything, whatever was
+		// decoded past the failing frame is released with `decoded`
+		stop = true;
+		group.wait();
+	}
+	return success;
+}
+
+bool LoadTiffFolderStreamed(const char *folder_path, std::function<void(int index, Frame frame)> on_frame,
+			    std::function<void(int loaded, int total)> on_progress, CancellationToken token) {
+	PROFILE_FUNCTION();
+
+	if (std::filesystem::is_regular_file(folder_path)) {
+		return LoadTiffStackStreamed(folder_path, on_frame, on_progress, token);
+	}
+
+	std::vector<std::string> files;
+	if (!ListTiffFiles(folder_path, files)) {
+		return false;
+	}
+	return StreamDecodedFrames(
+	    files.size(), [&](size_t i, Frame &frame) { return io::LoadTiff(files[i].c_str(), frame); },
+	    [&](size_t i) { return "file " + files[i]; }, on_frame, on_progress, token);
+}
+
+// offsets of all the directories (pages) of a tiff, so pages can be jumped to
+// directly with TIFFSetSubDirectory instead of walking the chain every time
+static std::vector<uint64_t> ListTiffPages(TIFF *tif) {
+	std::vector<uint64_t> offsets;
+	do {
+		offsets.push_back(TIFFCurrentDirOffset(tif));
+	} while (TIFFReadDirectory(tif));
+	return offsets;
+}
+
+bool LoadTiffStackStreamed(const char *path, std::function<void(int index, Frame frame)> on_frame,
+			   std::function<void(int loaded, int total)> on_progress, CancellationToken token) {
+	PROFILE_FUNCTION();
+
+	TIFF *first = OpenTiff(path);
+	if (!first) {
+		return false;
+	}
+	std::vector<uint64_t> pages = ListTiffPages(first);
+
+	// every decode borrows an open handle (libtiff handles can't be shared
+	// between threads), so the file is opened about once per worker instead
+	// of once per page
+	std::mutex handles_mutex;
+	std::vector<TIFF *> handles = {first};
+	std::vector<TIFF *> all_handles = {first};
+	auto decode = [&](size_t i, Frame &frame) {
+		TIFF *tif = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(handles_mutex);
+			if (!handles.empty()) {
+				tif = handles.back();
+				handles.pop_back();
+			}
+		}
+		if (!tif) {
+			tif = OpenTiff(path);
+			if (!tif) {
+				return false;
+			}
+			std::unique_lock<std::mutex> lock(handles_mutex);
+			all_handles.push_back(tif);
+		}
+
+		bool ok = TIFFSetSubDirectory(tif, pages[i]) && ReadTiffFrame(tif, path, frame);
+
+		std::unique_lock<std::mutex> lock(handles_mutex);
+		handles.push_back(tif);
+		return ok;
+	};
+
+	bool success = StreamDecodedFrames(
+	    pages.size(), decode, [&](size_t i) { return "page " + std::to_string(i) + " of " + path; }, on_frame,
+	    on_progress, token);
+
+	for (TIFF *tif : all_handles) {
+		TIFFClose(tif);
+	}
+	return success;
+}
+
+// identifies the files a cache was built from, any renamed, added, removed or
+// modified file gives a different id
+static uint64_t TiffFilesId(const std::vector<std::string> &files) {
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](const void *data, size_t size) {
+		for (size_t i = 0; i < size; i++) {
+			hash ^= ((const uint8_t *)data)[i];
+			hash *= 1099511628211ull;
+		}
+	};
+	for (auto &file : files) {
+		std::error_code error;
+		uint64_t size = std::filesystem::file_size(file, error);
+		int64_t time = std::filesystem::last_write_time(file, error).time_since_epoch().count();
+		std::string name = std::filesystem::path(file).filename().string();
+		mix(name.data(), name.size());
+		mix(&size, sizeof(size));
+		mix(&time, sizeof(time));
+	}
+	return hash;
+}
+
+bool LoadTiffFolderCached(const char *folder_path, const char *cache_path, FrameCache &cache,
+			  std::function<void(int index, Frame frame)> on_frame,
+			  std::function<void(int loaded, int total)> on_progress, CancellationToken token) {
+	PROFILE_FUNCTION();
+
+	std::vector<std::string> files;
+	if (!ListTiffFiles(folder_path, files)) {
+		return false;
+	}
+	if (files.empty()) {
+		return true;
+	}
+	uint64_t id = TiffFilesId(files);
+	int count = std::filesystem::is_regular_file(folder_path) ? GetTiffPageCount(folder_path) : (int)files.size();
+	if (count <= 0) {
+		return false;
+	}
+
+	if (std::filesystem::exists(cache_path) && cache.Open(cache_path) && cache.SourceId() == id &&
+	    cache.Count() == count) {
+		for (int i = 0; i < cache.Count(); i++) {
+			if (token.is_cancelled()) {
+				return false;
+			}
+			on_frame(i, cache.Get(i));
+			if (on_progress) {
+				on_progress(i + 1, cache.Count());
+			}
+		}
+		return true;
+	}
+	cache.Close();
+
+	// The cache is created once the first frame tells us the size and format,
+	// every frame is passed on as its view into the cache right after it's
+	// written, so the decoded copy is gone again. If the cache can't be
+	// created or written (e.g. not enough disk space) the rest of the frames
+	// are passed on decoded. The cache is discarded instead of closed then,
+	// the views passed on so far stay valid.
+	bool cached = false;
+	bool success = LoadTiffFolderStreamed(
+	    folder_path,
+	    [&](int index, Frame frame) {
+		    if (index == 0) {
+			    PixelFormat format = frame.Format() == PixelFormat::BGRA8 ? PixelFormat::Gray8 : frame.Format();
+			    cached = cache.Create(cache_path, count, frame.Width(), frame.Height(), format, id);
+		    }
+		    if (cached && !cache.Write(index, frame)) {
+			    printf("Failed to write frame %d to the frame cache, loading uncached\n", index);
+			    cache.Discard();
+			    cached = false;
+		    }
+		    on_frame(index, cached ? cache.Get(index) : std::move(frame));
+	    },
+	    on_progress, token);
+	if (!success) {
+		cache.Discard();
+		return false;
+	}
+	if (cached && !cache.Finish()) {
+		printf("Failed to finish the frame cache, it isn't kept\n");
+		cache.Discard();
+	}
+	return true;
+}
+
+bool LoadTiffFolder(const char *folder_path, std::vector<Frame> &frames) {
+	PROFILE_FUNCTION();
+
+	return LoadTiffFolderStreamed(folder_path,
+				      [&](int index, Frame frame) { frames.push_back(std::move(frame)); });
+}
+
+// the frame as it's written, BGRA is reduced to gray if asked to
+static Frame FrameForTiff(const Frame &frame, const TiffWriteOptions &options) {
+	if (options.gray && frame.Format() == PixelFormat::BGRA8) {
+		return Frame(frame.ToGray8());
+	}
+	return frame;
+}
+
+// codec tag for the options, falls back to Deflate if this libtiff was built
+// without ZSTD
+static uint16_t TiffCompressionTag(TiffCompression compression) {
+	switch (compression) {
+	case TiffCompression::LZW:
+		return COMPRESSION_LZW;
+	case TiffCompression::Deflate:
+		return COMPRESSION_ADOBE_DEFLATE;
+	case TiffCompression::ZSTD:
+		if (TIFFIsCODECConfigured(COMPRESSION_ZSTD)) {
+			return COMPRESSION_ZSTD;
 		}
+		static bool warned = (printf("ZSTD isn't available, writing Deflate compressed tiffs instead\n"), true);
+		(void)warned;
+		return COMPRESSION_ADOBE_DEFLATE;
+	default:
+		return COMPRESSION_NONE;
+	}
+}
+
+// Strips of roughly 64 KB, big enough for the codecs to do well and small
+// enough that readers don't have to decode much more than they need
+static uint32_t TiffRowsPerStrip(const Frame &frame) {
+	size_t row_size = (size_t)frame.Width() * frame.data.elemSize();
+	return (uint32_t)std::clamp<size_t>((64 * 1024) / std::max<size_t>(row_size, 1), 1, frame.Height());
+}
 
-		images.push_back(temp);
+// Sets up the current directory of `tif` for a frame, gray frames get one
+// sample in their own bit depth and BGRA frames 4 samples
+static void SetTiffTags(TIFF *tif, const Frame &frame, const TiffWriteOptions &options) {
+	PixelFormat format = frame.Format();
+	bool color = format == PixelFormat::BGRA8;
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, frame.Width());
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, frame.Height());
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, color ? 4 : 1);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, (int)frame.data.elemSize1() * 8);
+	TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT,
+		     format == PixelFormat::Gray32F ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT);
+	TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, color ? PHOTOMETRIC_RGB : PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, TiffRowsPerStrip(frame));
+
+	uint16_t compression = TiffCompressionTag(options.compression);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, compression);
+	if (compression != COMPRESSION_NONE && options.predictor) {
+		// differencing neighbours makes smooth micrographs compress a lot better
+		TIFFSetField(tif, TIFFTAG_PREDICTOR,
+			     format == PixelFormat::Gray32F ? PREDICTOR_FLOATINGPOINT : PREDICTOR_HORIZONTAL);
+	}
+}
+
+// Writes the pixels of a frame strip by strip, the directory has to be set up
+// with SetTiffTags
+static bool WriteTiffStrips(TIFF *tif, const Frame &frame) {
+	uint32_t rows_per_strip = TiffRowsPerStrip(frame);
+	size_t row_size = (size_t)frame.Width() * frame.data.elemSize();
+	// views can have padded rows, those are packed into a buffer first.
+	// libtiff may also modify the data it's given (predictor), so never pass
+	// the frame itself
+	std::vector<uint8_t> buffer(row_size * rows_per_strip);
+	for (uint32_t strip = 0, y = 0; y < (uint32_t)frame.Height(); strip++, y += rows_per_strip) {
+		uint32_t rows = std::min<uint32_t>(rows_per_strip, frame.Height() - y);
+		for (uint32_t r = 0; r < rows; r++) {
+			memcpy(buffer.data() + r * row_size, frame.data.ptr(y + r), row_size);
+		}
+		if (TIFFWriteEncodedStrip(tif, strip, buffer.data(), rows * row_size) < 0) {
+			printf("Error writing tiff\n");
+			return false;
+		}
 	}
 	return true;
 }
 
+// A growable in-memory file for libtiff, used to compress frames on the pool
+// without touching the output file
+struct MemoryTiff {
+	std::vector<uint8_t> data;
+	uint64_t position = 0;
+
+	static tmsize_t Read(thandle_t handle, void *buffer, tmsize_t size) {
+		auto *file = (MemoryTiff *)handle;
+		uint64_t position = std::min<uint64_t>(file->position, file->data.size());
+		size_t count = (size_t)std::min<uint64_t>(size, file->data.size() - position);
+		memcpy(buffer, file->data.data() + position, count);
+		file->position = position + count;
+		return (tmsize_t)count;
+	}
+	static tmsize_t Write(thandle_t handle, void *buffer, tmsize_t size) {
+		auto *file = (MemoryTiff *)handle;
+		if (file->position + size > file->data.size()) {
+			file->data.resize(file->position + size);
+		}
+		memcpy(file->data.data() + file->position, buffer, size);
+		file->position += size;
+		return size;
+	}
+	static toff_t Seek(thandle_t handle, toff_t offset, int whence) {
+		auto *file = (MemoryTiff *)handle;
+		if (whence == SEEK_CUR) {
+			offset += file->position;
+		} else if (whence == SEEK_END) {
+			offset += file->data.size();
+		}
+		file->position = offset;
+		return offset;
+	}
+	static int Close(thandle_t) { return 0; }
+	static toff_t Size(thandle_t handle) { return ((MemoryTiff *)handle)->data.size(); }
+	static int Map(thandle_t, void **, toff_t *) { return 0; }
+	static void Unmap(thandle_t, void *, toff_t) {}
+};
+
+// Compresses a frame's strips with the options' codec and returns the raw
+// (already encoded) strips so they can be copied into a file with
+// TIFFWriteRawStrip. Safe to call from several threads at once.
+static bool EncodeTiffStrips(const Frame &frame, const TiffWriteOptions &options,
+			     std::vector<std::vector<uint8_t>> &strips) {
+	PROFILE_FUNCTION();
+
+	MemoryTiff file;
+	TIFF *tif = TIFFClientOpen("memory", "w8m", (thandle_t)&file, MemoryTiff::Read, MemoryTiff::Write,
+				   MemoryTiff::Seek, MemoryTiff::Close, MemoryTiff::Size, MemoryTiff::Map,
+				   MemoryTiff::Unmap);
+	if (!tif) {
+		return false;
+	}
+	SetTiffTags(tif, frame, options);
+	bool ok = WriteTiffStrips(tif, frame);
+
+	// the strips are in the buffer as soon as they're written, the directory
+	// only follows on close
+	uint64_t *offsets = nullptr, *byte_counts = nullptr;
+	if (ok && TIFFGetField(tif, TIFFTAG_STRIPOFFSETS, &offsets) &&
+	    TIFFGetField(tif, TIFFTAG_STRIPBYTECOUNTS, &byte_counts)) {
+		uint32_t count = TIFFNumberOfStrips(tif);
+		strips.resize(count);
+		for (uint32_t i = 0; i < count; i++) {
+			strips[i].assign(file.data.begin() + offsets[i], file.data.begin() + offsets[i] + byte_counts[i]);
+		}
+	} else {
+		ok = false;
+	}
+	TIFFClose(tif);
+	return ok;
+}
+
 bool WriteTiff(const char *path, unsigned int *data, int width, int height) {
+	return WriteTiff(path, Frame::WrapBGRA(data, width, height));
+}
+
+bool WriteTiff(const char *path, const Frame &frame, const TiffWriteOptions &options) {
 	PROFILE_FUNCTION()
 
 	TIFF *tif = TIFFOpen(path, "w");
@@ -448,131 +1101,648 @@ bool WriteTiff(const char *path, unsigned int *data, int width, int height) {
 		printf("Could not open file %s\n", path);
 		return false;
 	}
+	Frame out = FrameForTiff(frame, options);
+	SetTiffTags(tif, out, options);
+	bool ok = WriteTiffStrips(tif, out);
+	TIFFClose(tif);
+	return ok;
+}
 
-	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
-	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, height);
-	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 4);
-	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
-	TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+bool WriteTiffFolder(const char *folder_path, const char *name_format, const std::vector<Frame> &frames,
+		     const TiffWriteOptions &options) {
+	PROFILE_FUNCTION()
 
-	for (int i = 0; i < height; i++) {
-		if (TIFFWriteScanline(tif, data + i * width, i, 0) < 0) {
-			printf("Error writing tiff\n");
-			TIFFClose(tif);
+	TiffSequenceWriter writer(folder_path, (int)frames.size(), options, name_format);
+	for (size_t i = 0; i < frames.size(); i++) {
+		writer.Write((int)i, frames[i]);
+	}
+	return writer.Finish();
+}
+
+bool WriteTiffStack(const char *path, const std::vector<Frame> &frames, const TiffWriteOptions &options) {
+	PROFILE_FUNCTION()
+
+	if (frames.empty()) {
+		printf("No images to write to %s\n", path);
+		return false;
+	}
+
+	TiffSequenceWriter writer(path, (int)frames.size(), options);
+	for (size_t i = 0; i < frames.size(); i++) {
+		writer.Write((int)i, frames[i]);
+	}
+	return writer.Finish();
+}
+
+// Flushes a written file (or a folder's entries) from the OS cache to the disk
+static bool SyncFile(const std::string &path) {
+#ifdef _WIN32
+	if (std::filesystem::is_directory(path)) {
+		return true;
+	}
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+				  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	bool ok = FlushFileBuffers(file);
+	CloseHandle(file);
+	return ok;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	bool ok = fsync(fd) == 0;
+	close(fd);
+	return ok;
+#endif
+}
+
+TiffSequenceWriter::TiffSequenceWriter(const std::string &path, int count, const TiffWriteOptions &options,
+				       const char *name_format, size_t max_pending)
+    : m_path(path), m_count(count), m_options(options), m_name_format(name_format ? name_format : ""),
+      m_stack(name_format == nullptr), m_max_pending(max_pending),
+      m_group(ThreadPool::GetThreadPool(), TaskPriority::Batch) {
+	if (m_max_pending == 0) {
+		m_max_pending = ThreadPool::GetThreadPool().get_thread_count() * 2;
+	}
+	if (!m_stack) {
+		std::error_code error;
+		std::filesystem::create_directories(m_path, error);
+	}
+}
+
+TiffSequenceWriter::~TiffSequenceWriter() {
+	if (!m_finished) {
+		Finish();
+	}
+}
+
+void TiffSequenceWriter::Write(int index, Frame frame) {
+	if (index < 0 || index >= m_count) {
+		printf("Frame %d is out of range for %s\n", index, m_path.c_str());
+		m_failed = true;
+		return;
+	}
+
+	// a worker writes queued frames meanwhile instead of blocking
+	if (m_stack) {
+		// Pages wait in m_ready until every earlier page is appended, so a
+		// count of queued pages could fill up with later pages while the next
+		// one still has to come. Limit how far ahead of the next page a frame
+		// may be instead, the next page itself always gets in.
+		m_group.wait_until([this, index] {
+			std::unique_lock<std::mutex> lock(m_mutex);
+			return index < m_next_page + (int)m_max_pending;
+		});
+	} else {
+		m_group.wait_until([this] {
+			std::unique_lock<std::mutex> lock(m_mutex);
+			return m_pending < m_max_pending;
+		});
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_pending++;
+	}
+
+	m_group.run([this, index, frame = std::move(frame)]() {
+		PROFILE_SCOPE(TiffSequenceWrite);
+
+		if (!m_stack) {
+			char name[256];
+			snprintf(name, sizeof(name), m_name_format.c_str(), index);
+			std::string path = (std::filesystem::path(m_path) / name).string();
+			bool ok = WriteTiff(path.c_str(), frame, m_options);
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_failed = m_failed || !ok;
+			m_files.push_back(path);
+			m_pending--;
+			return;
+		}
+
+		// pages are compressed here, in parallel, and appended in order
+		EncodedPage page{FrameForTiff(frame, m_options)};
+		bool compress = TiffCompressionTag(m_options.compression) != COMPRESSION_NONE;
+		if (compress && !EncodeTiffStrips(page.frame, m_options, page.strips)) {
+			m_failed = true;
+		}
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_ready[index] = std::move(page);
+		}
+		AppendPages();
+	});
+}
+
+void TiffSequenceWriter::AppendPages() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_appending) {
+		// whoever is appending picks this page up too
+		return;
+	}
+	m_appending = true;
+
+	auto it = m_ready.find(m_next_page);
+	while (it != m_ready.end()) {
+		EncodedPage page = std::move(it->second);
+		m_ready.erase(it);
+		lock.unlock();
+		bool ok = AppendPage(page);
+		lock.lock();
+
+		m_failed = m_failed || !ok;
+		m_next_page++;
+		it = m_ready.find(m_next_page);
+	}
+	m_appending = false;
+}
+
+bool TiffSequenceWriter::AppendPage(EncodedPage &page) {
+	if (!m_tif) {
+		// classic tiffs use 32 bit offsets, switch to BigTIFF before the
+		// pixel data plus the directories could get close to 4 GB.
+		// Compression can only make it smaller.
+		uint64_t bytes = (uint64_t)page.frame.data.total() * page.frame.data.elemSize() * m_count;
+		m_tif = TIFFOpen(m_path.c_str(), bytes > 0xF0000000ull ? "w8" : "w");
+		if (!m_tif) {
+			printf("Could not open file %s\n", m_path.c_str());
 			return false;
 		}
 	}
 
-	TIFFClose(tif);
-	return true;
+	TIFFSetField(m_tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+	// the tag only holds 16 bit numbers, leave it out on stacks too long for it
+	if (m_count <= 0xFFFF) {
+		TIFFSetField(m_tif, TIFFTAG_PAGENUMBER, (uint16_t)m_next_page, (uint16_t)m_count);
+	}
+	SetTiffTags(m_tif, page.frame, m_options);
+	bool ok = true;
+	if (!page.strips.empty()) {
+		for (size_t strip = 0; strip < page.strips.size() && ok; strip++) {
+			auto &raw = page.strips[strip];
+			ok = TIFFWriteRawStrip(m_tif, (uint32_t)strip, raw.data(), (tmsize_t)raw.size()) >= 0;
+		}
+	} else {
+		ok = WriteTiffStrips(m_tif, page.frame);
+	}
+	return ok && TIFFWriteDirectory(m_tif);
 }
 
-// write gif using gif.h
-bool WriteGIFOfImageSet(const char *path, std::vector<std::shared_ptr<Texture>> images, int delay, int loop) {
+bool TiffSequenceWriter::Finish() {
 	PROFILE_FUNCTION()
 
-	if (images.empty()) {
+	m_finished = true;
+	try {
+		m_group.wait();
+	} catch (const std::exception &e) {
+		printf("Error writing %s: %s\n", m_path.c_str(), e.what());
+		m_failed = true;
+	}
+
+	if (m_stack) {
+		if (m_next_page != m_count) {
+			printf("Only %d of %d pages were written to %s\n", m_next_page, m_count, m_path.c_str());
+			m_failed = true;
+		}
+		if (m_tif) {
+			TIFFClose(m_tif);
+			m_tif = nullptr;
+			m_failed = m_failed || !SyncFile(m_path);
+		}
+	} else {
+		for (auto &file : m_files) {
+			m_failed = m_failed || !SyncFile(file);
+		}
+#ifndef _WIN32
+		// the new directory entries have to reach the disk too
+		SyncFile(m_path);
+#endif
+	}
+
+	if (m_failed) {
+		printf("Failed to write %s\n", m_path.c_str());
+	}
+	return !m_failed;
+}
+
+// A frame as the RGBA8 image gif-h works on, scaled if asked to
+static cv::Mat GifImage(const Frame &frame, const GifWriteOptions &options) {
+	cv::Mat rgba;
+	if (frame.Format() == PixelFormat::BGRA8) {
+		cv::cvtColor(frame.data, rgba, cv::COLOR_BGRA2RGBA);
+	} else {
+		cv::cvtColor(frame.ToGray8(), rgba, cv::COLOR_GRAY2RGBA);
+	}
+	if (options.scale > 0.0f && options.scale < 1.0f) {
+		cv::resize(rgba, rgba, cv::Size(), options.scale, options.scale, cv::INTER_AREA);
+	}
+	return rgba.isContinuous() ? rgba : rgba.clone();
+}
+
+// A quantized frame and, if it could be encoded off the writing thread, its
+// complete gif block (control extension, descriptor, local palette, image data)
+struct GifBlock {
+	GifPalette palette;
+	// the palette index of every pixel ends up in its alpha byte
+	std::vector<uint8_t> indexed;
+	std::vector<uint8_t> encoded;
+};
+
+// Quantizes a frame and LZW encodes it. Frames are encoded on their own,
+// without gif-h's delta against the previous frame, so they can be done in
+// any order on any thread. gif-h only writes to files, so the block goes
+// through a temporary one. Where that can't be created (tmpfile() needs a
+// writable temp folder, on Windows often the root of the drive) `encoded` stays
+// empty and the block is written straight into the gif later instead.
+static void EncodeGifFrame(const cv::Mat &rgba, const GifWriteOptions &options, const GifPalette *shared_palette,
+			   GifBlock &block) {
+	PROFILE_FUNCTION();
+
+	uint32_t width = rgba.cols, height = rgba.rows;
+	if (shared_palette) {
+		block.palette = *shared_palette;
+	} else {
+		GifMakePalette(nullptr, rgba.data, width, height, 8, options.dither, &block.palette);
+	}
+
+	block.indexed.resize(rgba.total() * 4);
+	if (options.dither) {
+		GifDitherImage(nullptr, rgba.data, block.indexed.data(), width, height, &block.palette);
+	} else {
+		GifThresholdImage(nullptr, rgba.data, block.indexed.data(), width, height, &block.palette);
+	}
+
+	block.encoded.clear();
+	FILE *file = tmpfile();
+	if (!file) {
+		return;
+	}
+	GifWriteLzwImage(file, block.indexed.data(), 0, 0, width, height, options.delay, &block.palette);
+	block.encoded.resize(ftell(file));
+	rewind(file);
+	if (fread(block.encoded.data(), 1, block.encoded.size(), file) == block.encoded.size()) {
+		// only needed to write the block later
+		std::vector<uint8_t>().swap(block.indexed);
+	} else {
+		block.encoded.clear();
+	}
+	fclose(file);
+}
+
+// at most this many pixels of the sampled frames go into a global palette
+static constexpr size_t kGifPaletteSamplePixels = 1 << 20;
+
+bool WriteGif(const char *path, int count, const std::function<Frame(int index)> &get_frame,
+	      const GifWriteOptions &options) {
+	PROFILE_FUNCTION()
+
+	if (count <= 0) {
 		printf("No images to write to gif\n");
 		return false;
 	}
-	// Create gif
+
+	auto &pool = ThreadPool::GetThreadPool();
+	const int window = (int)pool.get_thread_count() * 2;
+
+	// frames are fetched on the calling thread, converted and encoded on the
+	// pool a window at a time, and written out in order
+	std::vector<Frame> frames(window);
+	std::vector<cv::Mat> images(window);
+	std::vector<GifBlock> blocks(window);
+	auto prepare = [&](int first, int n) {
+		for (int i = 0; i < n; i++) {
+			frames[i] = get_frame(first + i);
+		}
+		pool.parallel_for(0, n, 1, [&](size_t i) { images[i] = GifImage(frames[i], options); });
+	};
+
+	prepare(0, std::min(window, count));
+	int width = images[0].cols, height = images[0].rows;
+
+	// one palette for the whole sequence, built from frames spread evenly
+	// over it so e.g. a crack appearing late still gets its colors. Only a
+	// sample of their pixels is used, the palette is built on one thread.
+	GifPalette global_palette;
+	if (options.global_palette) {
+		PROFILE_SCOPE(GifGlobalPalette);
+		const int samples = std::min(count, 16);
+		std::vector<Frame> sampled_frames(samples);
+		for (int i = 0; i < samples; i++) {
+			sampled_frames[i] = get_frame((int)((int64_t)i * count / samples));
+		}
+		// nearest neighbour keeps the exact colors instead of blending them
+		const double pixels = (double)kGifPaletteSamplePixels / samples;
+		std::vector<cv::Mat> sampled(samples);
+		pool.parallel_for(0, samples, 1, [&](size_t i) {
+			cv::Mat rgba = GifImage(sampled_frames[i], options);
+			double factor = std::sqrt(pixels / (double)rgba.total());
+			if (factor < 1.0) {
+				cv::resize(rgba, rgba, cv::Size(), factor, factor, cv::INTER_NEAREST);
+			}
+			sampled[i] = rgba.reshape(4, 1);
+		});
+		sampled_frames.clear();
+
+		cv::Mat combined;
+		cv::hconcat(sampled, combined);
+		GifMakePalette(nullptr, combined.data, combined.cols, combined.rows, 8, options.dither,
+			       &global_palette);
+	}
+
 	GifWriter writer;
-	if (!GifBegin(&writer, path, images[0]->GetWidth(), images[0]->GetHeight(), delay, loop))
+	if (!GifBegin(&writer, path, width, height, options.delay, options.loop)) {
+		printf("Could not open file %s\n", path);
 		return false;
+	}
 
-	// all textures are the same size, so allocate once and then replace
-	// each time
-	uint32_t *data = (uint32_t *)malloc(images[0]->GetWidth() * images[0]->GetHeight() * 4);
-	for (int i = 0; i < images.size(); i++) {
-		images[i]->GetData(data);
-		GifWriteFrame(&writer, (uint8_t *)data, images[i]->GetWidth(), images[i]->GetHeight(), delay);
+	std::atomic<bool> ok = true;
+	for (int first = 0; first < count && ok; first += window) {
+		int n = std::min(window, count - first);
+		if (first > 0) {
+			prepare(first, n);
+		}
+		pool.parallel_for(0, n, 1, [&](size_t i) {
+			if (images[i].cols != width || images[i].rows != height) {
+				ok = false;
+				return;
+			}
+			EncodeGifFrame(images[i], options, options.global_palette ? &global_palette : nullptr,
+				       blocks[i]);
+		});
+		for (int i = 0; i < n && ok; i++) {
+			auto &block = blocks[i];
+			if (block.encoded.empty()) {
+				GifWriteLzwImage(writer.f, block.indexed.data(), 0, 0, width, height, options.delay,
+						 &block.palette);
+				ok = !ferror(writer.f);
+			} else {
+				ok = fwrite(block.encoded.data(), 1, block.encoded.size(), writer.f) ==
+				     block.encoded.size();
+			}
+		}
 	}
-	free(data);
-	// Close gif
 	GifEnd(&writer);
-	return true;
+
+	if (!ok) {
+		printf("Failed to write gif %s\n", path);
+	}
+	return ok;
+}
+
+bool WriteGif(const char *path, const std::vector<Frame> &frames, const GifWriteOptions &options) {
+	return WriteGif(path, (int)frames.size(), [&](int i) { return frames[i]; }, options);
+}
+
+CsvWriter::CsvWriter(const char *path, size_t buffer_size) : m_path(path), m_buffer(std::max<size_t>(buffer_size, 256)) {
+	m_file = fopen(path, "wb");
+	if (!m_file) {
+		printf("Could not open file %s\n", path);
+	}
+}
+
+CsvWriter &CsvWriter::Field(float value) {
+	char *out = Reserve(32);
+	auto result = std::to_chars(out, out + 32, value);
+	m_used = result.ptr - m_buffer.data();
+	return *this;
+}
+
+CsvWriter &CsvWriter::Integer(long long value) {
+	char *out = Reserve(24);
+	auto result = std::to_chars(out, out + 24, value);
+	m_used = result.ptr - m_buffer.data();
+	return *this;
+}
+
+CsvWriter &CsvWriter::Field(const char *text) {
+	size_t length = strlen(text);
+	if (length + 1 > m_buffer.size()) {
+		m_buffer.resize(length + 1);
+	}
+	memcpy(Reserve(length), text, length);
+	m_used += length;
+	return *this;
+}
+
+void CsvWriter::EndRow() {
+	if (m_used + 1 > m_buffer.size()) {
+		Flush();
+	}
+	m_buffer[m_used++] = '\n';
+	m_row_start = true;
+}
+
+char *CsvWriter::Reserve(size_t size) {
+	if (m_used + size + 1 > m_buffer.size()) {
+		Flush();
+	}
+	if (!m_row_start) {
+		m_buffer[m_used++] = ',';
+	}
+	m_row_start = false;
+	return m_buffer.data() + m_used;
+}
+
+void CsvWriter::Flush() {
+	if (m_file && m_used > 0 && fwrite(m_buffer.data(), 1, m_used, m_file) != m_used) {
+		m_failed = true;
+	}
+	m_used = 0;
+}
+
+bool CsvWriter::Close() {
+	if (!m_file) {
+		return false;
+	}
+	Flush();
+	bool ok = fclose(m_file) == 0 && !m_failed;
+	m_file = nullptr;
+	if (!ok) {
+		printf("Failed to write %s\n", m_path.c_str());
+	}
+	return ok;
 }
 
-bool WriteCSV(const char *path, std::vector<std::vector<std::vector<float>>> &data) {
-	FILE *f = fopen(path, "w");
+bool WriteColumns(const char *path, const std::vector<Column> &columns) {
+	PROFILE_FUNCTION();
+	static constexpr size_t kHeaderSize = 32;
+	static constexpr size_t kDescriptorSize = 64;
+	static constexpr size_t kAlignment = 64;
+
+	size_t rows = columns.empty() ? 0 : columns[0].rows;
+	for (auto &column : columns) {
+		if (column.rows != rows || column.name.size() >= 48) {
+			printf("Column %s doesn't fit the table written to %s\n", column.name.c_str(), path);
+			return false;
+		}
+	}
+
+	FILE *f = fopen(path, "wb");
 	if (!f) {
 		printf("Could not open file %s\n", path);
 		return false;
 	}
-	for (int i = 0; i < data.size(); i++) {
-		for (int j = 0; j < data[i][0].size(); j++) {
-			fprintf(f, "%f", data[i][0][j]);
-			if (j < data[i][0].size() - 1)
-				fprintf(f, ",");
+
+	auto align = [](size_t value) { return (value + kAlignment - 1) / kAlignment * kAlignment; };
+	std::vector<uint8_t> header(align(kHeaderSize + kDescriptorSize * columns.size()), 0);
+	uint32_t version = 1;
+	uint32_t column_count = (uint32_t)columns.size();
+	uint64_t row_count = rows;
+	memcpy(header.data(), "EDACOLS", 8);
+	memcpy(header.data() + 8, &version, 4);
+	memcpy(header.data() + 12, &column_count, 4);
+	memcpy(header.data() + 16, &row_count, 8);
+
+	uint64_t offset = header.size();
+	for (size_t i = 0; i < columns.size(); i++) {
+		uint8_t *descriptor = header.data() + kHeaderSize + kDescriptorSize * i;
+		uint32_t type = (uint32_t)columns[i].type;
+		memcpy(descriptor, columns[i].name.c_str(), columns[i].name.size());
+		memcpy(descriptor + 48, &type, 4);
+		memcpy(descriptor + 56, &offset, 8);
+		offset += align(rows * 4);
+	}
+
+	static const uint8_t padding[kAlignment] = {};
+	bool ok = fwrite(header.data(), 1, header.size(), f) == header.size();
+	for (size_t i = 0; i < columns.size() && ok; i++) {
+		size_t size = rows * 4;
+		ok = fwrite(columns[i].data, 1, size, f) == size &&
+		     fwrite(padding, 1, align(size) - size, f) == align(size) - size;
+	}
+	ok = fclose(f) == 0 && ok;
+	if (!ok) {
+		printf("Failed to write %s\n", path);
+	}
+	return ok;
+}
+
+bool IsColumnarPath(const std::string &path) { return std::filesystem::path(path).extension() == ".cols"; }
+
+bool WriteWidths(const char *path, const std::vector<std::vector<std::vector<float>>> &widths) {
+	return IsColumnarPath(path) ? WriteWidthsColumns(path, widths) : WriteCSV(path, widths);
+}
+
+bool WriteCSV(const char *path, const std::vector<std::vector<std::vector<float>>> &widths) {
+	PROFILE_FUNCTION();
+	CsvWriter csv(path);
+	if (!csv.IsOpen()) {
+		return false;
+	}
+	csv.Field("frame").Field("crack").Field("sample").Field("width").EndRow();
+	for (size_t i = 0; i < widths.size(); i++) {
+		for (size_t j = 0; j < widths[i].size(); j++) {
+			for (size_t k = 0; k < widths[i][j].size(); k++) {
+				csv.Field(i).Field(j).Field(k).Field(widths[i][j][k]).EndRow();
+			}
 		}
-		fprintf(f, "\n");
 	}
-	fclose(f);
-	return true;
+	return csv.Close();
+}
+
+bool WriteWidthsColumns(const char *path, const std::vector<std::vector<std::vector<float>>> &widths) {
+	PROFILE_FUNCTION();
+	std::vector<int32_t> frames, cracks, samples;
+	std::vector<float> values;
+	for (size_t i = 0; i < widths.size(); i++) {
+		for (size_t j = 0; j < widths[i].size(); j++) {
+			for (size_t k = 0; k < widths[i][j].size(); k++) {
+				frames.push_back((int32_t)i);
+				cracks.push_back((int32_t)j);
+				samples.push_back((int32_t)k);
+				values.push_back(widths[i][j][k]);
+			}
+		}
+	}
+	return WriteColumns(path, {{"frame", frames}, {"crack", cracks}, {"sample", samples}, {"width", values}});
 }
 
 bool WriteCSV(const char *path, std::vector<std::vector<cv::Point2f>> &trackedPts,
 	      std::vector<std::vector<float>> &widths) {
-	std::ofstream f(path);
-	if (!f.is_open()) {
-		std::cerr << "Could not open file " << path << std::endl;
+	CsvWriter csv(path);
+	if (!csv.IsOpen()) {
 		return false;
 	}
 	// header
-	f << "frame";
+	csv.Field("frame");
 	auto nPairs = widths.empty() ? 0 : widths[0].size();
 	for (size_t p = 0; p < nPairs; ++p)
-		f << ",width" << p;
+		csv.Field(("width" + std::to_string(p)).c_str());
 	auto nPts = trackedPts.empty() ? 0 : trackedPts[0].size();
 	for (size_t j = 0; j < nPts; ++j)
-		f << ",pt" << j << "_x,pt" << j << "_y";
-	f << "\n";
+		csv.Field(("pt" + std::to_string(j) + "_x").c_str()).Field(("pt" + std::to_string(j) + "_y").c_str());
+	csv.EndRow();
 
 	auto nFrames = std::min(widths.size(), trackedPts.size());
 	for (size_t i = 0; i < nFrames; ++i) {
-		f << i;
+		csv.Field(i);
 		for (auto w : widths[i])
-			f << "," << w;
+			csv.Field(w);
 		for (auto &pt : trackedPts[i])
-			f << "," << pt.x << "," << pt.y;
-		f << "\n";
+			csv.Field(pt.x).Field(pt.y);
+		csv.EndRow();
 	}
-	return true;
+	return csv.Close();
+}
+
+bool SaveAnalysis(const char *path, const std::vector<std::vector<float>> &histograms,
+		  const std::vector<float> &avg_histogram, const std::vector<float> &snrs, float avg_snr) {
+	return IsColumnarPath(path) ? SaveAnalysisColumns(path, histograms, snrs)
+				    : SaveAnalysisCsv(path, histograms, avg_histogram, snrs, avg_snr);
 }
 
 bool SaveAnalysisCsv(const char *path, const std::vector<std::vector<float>> &histograms,
 		     const std::vector<float> &avg_histogram, const std::vector<float> &snrs, float avg_snr) {
-	std::ofstream f(path);
-	if (!f.is_open()) {
-		std::cerr << "Could not open file " << path << std::endl;
+	PROFILE_FUNCTION();
+	CsvWriter csv(path);
+	if (!csv.IsOpen()) {
 		return false;
 	}
 	int bins = avg_histogram.size();
 
 	// header
-	f << "frame,snr";
+	csv.Field("frame").Field("snr");
 	for (int b = 0; b < bins; ++b)
-		f << ",bin" << b;
-	f << "\n";
+		csv.Field(("bin" + std::to_string(b)).c_str());
+	csv.EndRow();
 
 	// per-frame rows
 	size_t n = std::min(histograms.size(), snrs.size());
 	for (size_t i = 0; i < n; ++i) {
-		f << i << "," << snrs[i];
+		csv.Field(i).Field(snrs[i]);
 		for (int b = 0; b < bins; ++b)
-			f << "," << histograms[i][b];
-		f << "\n";
+			csv.Field(histograms[i][b]);
+		csv.EndRow();
 	}
 
 	// average row
-	f << "avg," << avg_snr;
+	csv.Field("avg").Field(avg_snr);
 	for (int b = 0; b < bins; ++b)
-		f << "," << avg_histogram[b];
-	f << "\n";
-	return true;
+		csv.Field(avg_histogram[b]);
+	csv.EndRow();
+	return csv.Close();
+}
+
+bool SaveAnalysisColumns(const char *path, const std::vector<std::vector<float>> &histograms,
+			 const std::vector<float> &snrs) {
+	PROFILE_FUNCTION();
+	size_t n = std::min(histograms.size(), snrs.size());
+	size_t bins = histograms.empty() ? 0 : histograms[0].size();
+
+	std::vector<int32_t> frames(n);
+	std::vector<float> snr(snrs.begin(), snrs.begin() + n);
+	std::vector<std::vector<float>> bin_values(bins, std::vector<float>(n));
+	for (size_t i = 0; i < n; ++i) {
+		frames[i] = (int32_t)i;
+		for (size_t b = 0; b < bins; ++b)
+			bin_values[b][i] = histograms[i][b];
+	}
+
+	std::vector<Column> columns = {{"frame", frames}, {"snr", snr}};
+	for (size_t b = 0; b < bins; ++b)
+		columns.emplace_back("bin" + std::to_string(b), bin_values[b]);
+	return WriteColumns(path, columns);
 }
 } // namespace io
 
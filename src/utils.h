@@ -1,16 +1,29 @@
 #pragma once
 
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
 #include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <string>
 #include <vector>
-#include <functional>
 
+#include <OpenGL/FrameTextures.h>
+#include <OpenGL/FrameThumbnails.h>
 #include <OpenGL/Texture.h>
+#include <core/Frame.hpp>
+#include <core/FrameCache.hpp>
+#include <core/FrameStore.hpp>
+#include <core/ThreadPool.hpp>
 #include <core/Tiler.hpp>
 
 #include <opencv2/opencv.hpp>
 
+typedef struct tiff TIFF;
+
 namespace utils {
 // TODO: fill in the filter for win32 (although it may not matter?)
 std::string OpenFileDialog(const char *open_path = ".", const char *title = "",
@@ -19,33 +32,20 @@ std::string OpenFileDialog(const char *open_path = ".", const char *title = "",
 std::string SaveFileDialog(const char *save_path = ".", const char *title = "",
 			   const char *filter = "");
 
-// gets the data from a texture
-// assumes data is already allocated
-void GetDataFromTexture(unsigned int *data, std::shared_ptr<Texture> texture,
-			int width = 0, int height = 0);
-
-// gets the data from a vector of textures
-// doesn't assume data is already allocated and will allocate if not
-void GetDataFromTextures(std::vector<uint32_t *> &data, int width, int height,
-			 std::vector<std::shared_ptr<Texture>> &textures);
-
-// loads data into textures and frees the data
-// basically a helper function to consolidate a lot of the code in ImageSet.cpp
-void LoadDataIntoTexturesAndFree(
-    std::vector<std::shared_ptr<Texture>> &textures,
-    std::vector<uint32_t *> &data, int width, int height);
-
-// Creates textures from tiles for preview
-void CreateTileTextures(
-    std::vector<std::shared_ptr<Texture>> &tile_textures,
-    const std::shared_ptr<Texture> &source_texture,
-    const TileConfig &tile_config);
-void UpdateTileTextures(
-    std::vector<std::shared_ptr<Texture>> &tile_textures,
-    const std::shared_ptr<Texture> &source_texture,
-    const TileConfig &tile_config);
+// Copies frames of a store (all of them if indices is empty) into new BGRA
+// buffers for the uint32_t* based modules, which process in place. pixels
+// gets a pointer into each of the returned frames.
+std::vector<Frame> CopyFramesBGRA(const FrameStore &store, const std::vector<int> &indices,
+				  std::vector<uint32_t *> &pixels);
+
+// A BGRA copy of a frame that fits in max_size x max_size, keeping the aspect
+// ratio. Big frames are halved with pyrDown first, so the final resize only
+// averages a few pixels per output pixel.
+cv::Mat MakeThumbnail(const Frame &frame, int max_size);
 
 bool DirectoryContainsTiff(const std::filesystem::path &path);
+// a single (possibly multi-page) .tif/.tiff file
+bool IsTiffFile(const std::filesystem::path &path);
 } // namespace utils
 
 // UI helper functions
@@ -54,14 +54,16 @@ namespace ui {
 // Parameters:
 //   window_title: The title of the window
 //   is_open: Boolean reference that controls whether the window is open
-//   tile_textures: Vector of texture pointers to display in the window
+//   source: The texture of the image that's split, nullptr if there's none
+//   tiles: Where the tiles are in the image, see Tiler::TileRects
 //   refresh_callback: Optional callback function to refresh the tiles
 //   tile_size: Size of individual tile previews in the grid (default: 100)
 //   columns: Number of tile columns in the grid (default: 4)
 void DisplayTilePreviewWindow(
     const char* window_title,
     bool& is_open,
-    std::vector<std::shared_ptr<Texture>>& tile_textures,
+    const Texture* source,
+    const std::vector<cv::Rect>& tiles,
     std::function<void()> refresh_callback = nullptr,
     int tile_size = 100,
     int columns = 4);
@@ -70,15 +72,16 @@ void DisplayTilePreviewWindow(
 // Parameters:
 //   window_title: The title of the window
 //   is_open: Boolean reference that controls whether the window is open
-//   textures: Vector of texture pointers representing frames
+//   thumbnails: Thumbnails of the frames, synced by the caller
 //   selected_map: Map of selected indices
-//   on_remove_callback: Callback function when removing selected frames
+//   on_remove_callback: Callback function when removing selected frames,
+//                       removing is disabled without one
 //   frame_size: Size of individual frame previews in the grid (default: 100)
 //   columns: Number of frame columns in the grid (default: 6)
 void DisplayFrameSelectionWindow(
     const char* window_title,
     bool& is_open,
-    std::vector<std::shared_ptr<Texture>>& textures,
+    const FrameThumbnails& thumbnails,
     std::map<int, int>& selected_map,
     std::function<void()> on_remove_callback,
     int frame_size = 100,
@@ -86,26 +89,241 @@ void DisplayFrameSelectionWindow(
 } // namespace ui
 
 namespace io {
+// always BGRA (8 bit per channel)
 uint32_t *LoadTiff(const char *path, int &width, int &height);
+// keeps 8/16 bit and float grayscale as they are, anything else becomes BGRA
+bool LoadTiff(const char *path, Frame &frame);
+
+enum class TiffCompression { None, LZW, Deflate, ZSTD };
+
+struct TiffWriteOptions {
+	TiffCompression compression = TiffCompression::None;
+	// horizontal differencing (floating point for float frames), only used
+	// with compression
+	bool predictor = true;
+	// write BGRA frames as 8 bit gray
+	bool gray = false;
+};
 
 bool WriteTiff(const char *path, unsigned int *data, int width, int height);
+// grayscale frames are written with one sample in their own bit depth
+bool WriteTiff(const char *path, const Frame &frame, const TiffWriteOptions &options = {});
+
+// Writes every frame to its own file in folder_path, named by name_format
+// (printf style, gets the frame index). The files are written in parallel.
+bool WriteTiffFolder(const char *folder_path, const char *name_format, const std::vector<Frame> &frames,
+		     const TiffWriteOptions &options = {});
+
+// Writes all frames as the pages of one multi-page tiff, as BigTIFF when the
+// stack gets too big for 32 bit offsets. Compressed pages are encoded in
+// parallel and appended in order.
+bool WriteTiffStack(const char *path, const std::vector<Frame> &frames, const TiffWriteOptions &options = {});
+
+// Write-behind output for a sequence. Frames are handed over as soon as they
+// are final and get written on the pool while the caller goes on computing.
+// If name_format is given every frame becomes its own file in the folder at
+// `path` (printf style name, gets the frame index), otherwise all frames are
+// written as the pages of a stack at `path`. Stack pages are compressed in
+// parallel and appended in index order.
+// Write blocks while max_pending frames (default twice the thread count) are
+// waiting to be written. For stacks that is every frame max_pending or more
+// pages after the first page that isn't written yet, so frames may come out of
+// order from several threads (e.g. a parallel_for), but a single thread has to
+// pass them roughly in order or it waits for a page only it could write.
+class TiffSequenceWriter {
+      public:
+	TiffSequenceWriter(const std::string &path, int count, const TiffWriteOptions &options = {},
+			   const char *name_format = nullptr, size_t max_pending = 0);
+	~TiffSequenceWriter();
+
+	TiffSequenceWriter(const TiffSequenceWriter &) = delete;
+	TiffSequenceWriter &operator=(const TiffSequenceWriter &) = delete;
+
+	// Queues a frame. The pixels are shared, not copied, so the frame must
+	// not be modified afterwards.
+	void Write(int index, Frame frame);
+
+	// Waits for all queued frames and syncs the written files to disk,
+	// false if anything failed
+	bool Finish();
+
+      private:
+	struct EncodedPage {
+		Frame frame;
+		std::vector<std::vector<uint8_t>> strips;
+	};
+
+	// appends the queued pages that are next in order to the stack, only
+	// ever runs on one thread at a time
+	void AppendPages();
+	bool AppendPage(EncodedPage &page);
+
+	std::string m_path;
+	int m_count;
+	TiffWriteOptions m_options;
+	std::string m_name_format;
+	bool m_stack;
+	size_t m_max_pending;
+	bool m_finished = false;
+
+	std::mutex m_mutex;
+	// frames being written to their own files
+	size_t m_pending = 0;
+	std::atomic<bool> m_failed = false;
+	std::vector<std::string> m_files;
+
+	std::map<int, EncodedPage> m_ready;
+	int m_next_page = 0;
+	bool m_appending = false;
+	TIFF *m_tif = nullptr;
+
+	// last, so it waits for the tasks before anything they use is destroyed
+	TaskGroup m_group;
+};
+
+// Multi-page (stack) and BigTIFF files. Pages can be read individually, the
+// count is -1 if the file can't be opened.
+int GetTiffPageCount(const char *path);
+bool LoadTiffPage(const char *path, int page, Frame &frame);
+
+bool LoadTiffFolder(const char *folder_path, std::vector<Frame> &frames);
+
+// Decodes the tiffs of a folder concurrently on the thread pool. Every frame is
+// passed to on_frame on the calling thread in sorted file order as soon as it
+// and all frames before it are decoded.
+// on_progress gets the number of frames delivered so far and the total.
+// Fails if a file can't be read, the frames don't all have the same size or
+// the token is cancelled (checked between frames).
+// folder_path can also be a single multi-page tiff, see LoadTiffStackStreamed.
+bool LoadTiffFolderStreamed(
+    const char *folder_path, std::function<void(int index, Frame frame)> on_frame,
+    std::function<void(int loaded, int total)> on_progress = nullptr,
+    CancellationToken token = CancellationToken());
+// Same for the pages of a multi-page tiff. The page offsets are read once and
+// every worker keeps its own open handle, so the file isn't reopened per page.
+bool LoadTiffStackStreamed(
+    const char *path, std::function<void(int index, Frame frame)> on_frame,
+    std::function<void(int loaded, int total)> on_progress = nullptr,
+    CancellationToken token = CancellationToken());
+
+// Same as LoadTiffFolderStreamed but goes through the frame cache at cache_path.
+// If the cache was written from the same files (names, sizes and modification
+// times) the frames are mapped straight from it without decoding anything,
+// otherwise the folder is decoded and the cache rewritten. Frames are stored
+// like FrameStore keeps them: single channel in the first frame's format.
+// The frames passed to on_frame are views into `cache`, it has to outlive them.
+// While the cache is (re)written every frame is passed on as soon as it's in
+// the cache. If the cache can't be written the remaining frames are passed on
+// decoded. A cancelled load discards the cache, so it's rewritten next time.
+bool LoadTiffFolderCached(
+    const char *folder_path, const char *cache_path, FrameCache &cache,
+    std::function<void(int index, Frame frame)> on_frame,
+    std::function<void(int loaded, int total)> on_progress = nullptr,
+    CancellationToken token = CancellationToken());
+
+struct GifWriteOptions {
+	// in hundredths of a second
+	int delay = 100;
+	// 0 loops forever
+	int loop = 0;
+	// one palette built from the whole sequence instead of one per frame,
+	// colors stay stable between frames and only one palette is built
+	bool global_palette = false;
+	// frames are downscaled by this factor (0-1) first
+	float scale = 1.0f;
+	bool dither = false;
+};
+
+// Frames are converted, quantized and encoded concurrently on the pool, a
+// window at a time, and written in order. get_frame is only called on the
+// calling thread, so it doesn't have to be thread safe.
+bool WriteGif(const char *path, int count, const std::function<Frame(int index)> &get_frame,
+	      const GifWriteOptions &options = {});
+bool WriteGif(const char *path, const std::vector<Frame> &frames, const GifWriteOptions &options = {});
+
+// Buffered writer for numeric CSV tables. Numbers are formatted with
+// std::to_chars (the shortest text that reads back to the same value) into a
+// large buffer, which is written with one fwrite whenever it fills up.
+class CsvWriter {
+      public:
+	explicit CsvWriter(const char *path, size_t buffer_size = 1 << 20);
+	~CsvWriter() { Close(); }
+
+	CsvWriter(const CsvWriter &) = delete;
+	CsvWriter &operator=(const CsvWriter &) = delete;
+
+	bool IsOpen() const { return m_file != nullptr; }
+
+	CsvWriter &Field(float value);
+	CsvWriter &Field(std::integral auto value) { return Integer((long long)value); }
+	CsvWriter &Field(const char *text);
+	void EndRow();
+
+	// Flushes and closes the file, false if any write failed
+	bool Close();
+
+      private:
+	CsvWriter &Integer(long long value);
+	// room for `size` more characters after the separator of the next field
+	char *Reserve(size_t size);
+	void Flush();
+
+	std::string m_path;
+	FILE *m_file = nullptr;
+	std::vector<char> m_buffer;
+	size_t m_used = 0;
+	bool m_row_start = true;
+	bool m_failed = false;
+};
+
+// Binary columnar results, for tables too big to parse as text. Every column
+// has the same number of rows and is stored contiguously, so a reader can
+// mmap the file and use the columns in place.
+//
+// Layout (little endian):
+//   header, 32 bytes: char magic[8] = "EDACOLS", uint32 version (1),
+//                     uint32 column count, uint64 row count, uint64 0
+//   one descriptor per column, 64 bytes: char name[48] (NUL padded),
+//                     uint32 type (ColumnType), uint32 0, uint64 data offset
+//   column data, 4 bytes per value, every column starts 64 byte aligned
+enum class ColumnType : uint32_t { Int32, Float32 };
+
+struct Column {
+	Column(std::string name, const std::vector<int32_t> &values)
+	    : name(std::move(name)), type(ColumnType::Int32), data(values.data()), rows(values.size()) {}
+	Column(std::string name, const std::vector<float> &values)
+	    : name(std::move(name)), type(ColumnType::Float32), data(values.data()), rows(values.size()) {}
+
+	std::string name;
+	ColumnType type;
+	const void *data;
+	size_t rows;
+};
+
+bool WriteColumns(const char *path, const std::vector<Column> &columns);
 
-bool LoadTiffFolder(const char *folder_path, std::vector<uint32_t *> &images,
-		    int &width, int &height);
+// Results are written as columns if the path ends in .cols, as CSV otherwise
+bool IsColumnarPath(const std::string &path);
 
-bool WriteGIFOfImageSet(const char *path,
-			std::vector<std::shared_ptr<Texture>> images,
-			int delay = 100, int loop = 0);
+// Crack width profiles, indexed [frame][crack][sample]. One row per sample
+// with the columns frame, crack, sample and width.
+bool WriteWidths(const char *path, const std::vector<std::vector<std::vector<float>>> &widths);
+bool WriteCSV(const char *path, const std::vector<std::vector<std::vector<float>>> &widths);
+bool WriteWidthsColumns(const char *path, const std::vector<std::vector<std::vector<float>>> &widths);
 
-bool WriteCSV(const char *path,
-	      std::vector<std::vector<std::vector<float>>> &data);
 bool WriteCSV(const char *path, std::vector<std::vector<cv::Point2f>> &points,
 	      std::vector<std::vector<float>> &data);
 
+// Per frame SNR and histogram. The CSV has a last row with the averages, the
+// columnar file leaves them out (they're just the column means).
+bool SaveAnalysis(const char *path, const std::vector<std::vector<float>> &histograms,
+		  const std::vector<float> &avg_histogram, const std::vector<float> &snrs, float avg_snr);
 bool SaveAnalysisCsv(const char *path,
 		     const std::vector<std::vector<float>> &histograms,
 		     const std::vector<float> &avg_histogram,
 		     const std::vector<float> &snrs, float avg_snr);
+bool SaveAnalysisColumns(const char *path, const std::vector<std::vector<float>> &histograms,
+			 const std::vector<float> &snrs);
 } // namespace io
 
 class Profiler {